@@ -0,0 +1,416 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include <lua.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+namespace smartlua
+{
+
+/**
+ * Counters of allocator installed in lua state
+ */
+struct AllocatorStats
+{
+	std::size_t allocations = 0;
+	std::size_t deallocations = 0;
+	/// Bytes currently allocated by lua
+	std::size_t bytes = 0;
+	/// Highest number of bytes allocated by lua at once
+	std::size_t peakBytes = 0;
+	/// Bytes taken from system, including slabs and arena chunks
+	std::size_t reservedBytes = 0;
+	/// Allocations refused because of memory limit
+	std::size_t rejections = 0;
+};
+
+namespace impl
+{
+
+/**
+ * Common lua_Alloc dispatch, counting and memory limit of allocators
+ *
+ * Derived allocator provides acquire, release and resize working on exact sizes,
+ * as lua always passes size of the block it frees or resizes. Allocation which would
+ * exceed the limit fails, so lua raises memory error in the script, reported by
+ * calls as Error::Code::MEMORY_ERROR. Shrinking blocks never fails, as lua expects.
+ */
+template<class Derived>
+class AllocatorBase
+{
+public:
+	/**
+	 * \param bytes Highest number of live bytes of the state, 0 for no limit
+	 */
+	void setLimit(std::size_t bytes) { byteLimit = bytes; }
+	std::size_t getLimit() const { return byteLimit; }
+
+	/**
+	 * lua_Alloc function, with allocator as user data
+	 */
+	static void * allocate(void * ud, void * ptr, std::size_t osize, std::size_t nsize)
+	{
+		auto self = static_cast<Derived *>(ud);
+		if(nsize == 0)
+		{
+			if(ptr)
+			{
+				self->release(ptr, osize);
+				self->counted(osize, 0);
+			}
+			return nullptr;
+		}
+
+		// for new blocks osize is the type of lua object, not a size
+		std::size_t current = ptr ? osize : 0;
+		if(self->byteLimit && nsize > current && self->counters.bytes - current + nsize > self->byteLimit)
+		{
+			++self->counters.rejections;
+			return nullptr;
+		}
+
+		void * result = ptr ? self->resize(ptr, osize, nsize) : self->acquire(nsize);
+		if(result)
+			self->counted(ptr ? osize : 0, nsize);
+		return result;
+	}
+
+	const AllocatorStats & stats() const { return counters; }
+
+protected:
+	void counted(std::size_t osize, std::size_t nsize)
+	{
+		if(osize == 0)
+			++counters.allocations;
+		if(nsize == 0)
+			++counters.deallocations;
+		counters.bytes += nsize;
+		counters.bytes -= osize;
+		counters.peakBytes = std::max(counters.peakBytes, counters.bytes);
+	}
+
+	AllocatorStats counters;
+	std::size_t byteLimit = 0;
+};
+
+}
+
+/**
+ * Allocator using malloc, for counting and limiting memory of state only
+ */
+class MallocAllocator: public impl::AllocatorBase<MallocAllocator>
+{
+public:
+	void * acquire(std::size_t size)
+	{
+		return std::malloc(size);
+	}
+
+	void release(void * ptr, std::size_t)
+	{
+		std::free(ptr);
+	}
+
+	void * resize(void * ptr, std::size_t, std::size_t nsize)
+	{
+		return std::realloc(ptr, nsize);
+	}
+};
+
+/**
+ * Allocator keeping small blocks in slabs of blocks of the same size
+ *
+ * Blocks up to MAX_SMALL bytes are rounded up to multiple of GRANULE, and taken from
+ * free list of their size class, or cut from the slab of that class. Freed blocks
+ * go back to their free list and are reused only for the same size class, so a
+ * long-running state doesn't fragment the heap. Larger blocks are allocated with
+ * malloc. Slabs are released when the allocator is destroyed, after its state.
+ * Large block shrunk into size class is moved to a slab, or if there is no memory
+ * for that, kept and released with slabs, so shrinking fails only when even that
+ * is not possible.
+ */
+class PoolAllocator: public impl::AllocatorBase<PoolAllocator>
+{
+public:
+	static constexpr std::size_t GRANULE = 16;
+	static constexpr std::size_t MAX_SMALL = 256;
+	static constexpr std::size_t SLAB_SIZE = 64 * 1024;
+
+	PoolAllocator()
+	{
+		for(auto & sizeClass: classes)
+			sizeClass = SizeClass { nullptr, nullptr, nullptr };
+		slabs.reserve(16);
+	}
+
+	PoolAllocator(const PoolAllocator &) = delete;
+	PoolAllocator & operator =(const PoolAllocator &) = delete;
+
+	~PoolAllocator()
+	{
+		for(void * slab: slabs)
+			std::free(slab);
+	}
+
+	void * acquire(std::size_t size)
+	{
+		if(size > MAX_SMALL)
+		{
+			void * block = std::malloc(size);
+			if(block)
+				counters.reservedBytes += size;
+			return block;
+		}
+
+		auto & sizeClass = classes[classOf(size)];
+		if(sizeClass.free)
+		{
+			FreeBlock * block = sizeClass.free;
+			sizeClass.free = block->next;
+			return block;
+		}
+
+		std::size_t blockSize = (classOf(size) + 1) * GRANULE;
+		if(sizeClass.cursor == sizeClass.limit)
+		{
+			// one entry is left spare for large block kept by resize
+			if(!spare(2))
+				return nullptr;
+			char * slab = static_cast<char *>(std::malloc(SLAB_SIZE));
+			if(!slab)
+				return nullptr;
+			slabs.push_back(slab);
+			counters.reservedBytes += SLAB_SIZE;
+			sizeClass.cursor = slab;
+			sizeClass.limit = slab + SLAB_SIZE / blockSize * blockSize;
+		}
+
+		void * block = sizeClass.cursor;
+		sizeClass.cursor += blockSize;
+		return block;
+	}
+
+	void release(void * ptr, std::size_t size)
+	{
+		if(size > MAX_SMALL)
+		{
+			std::free(ptr);
+			counters.reservedBytes -= size;
+			return;
+		}
+
+		auto & sizeClass = classes[classOf(size)];
+		auto block = static_cast<FreeBlock *>(ptr);
+		block->next = sizeClass.free;
+		sizeClass.free = block;
+	}
+
+	void * resize(void * ptr, std::size_t osize, std::size_t nsize)
+	{
+		if(osize > MAX_SMALL && nsize > MAX_SMALL)
+		{
+			void * block = std::realloc(ptr, nsize);
+			if(block)
+				counters.reservedBytes += nsize - osize;
+			return block;
+		}
+
+		if(osize <= MAX_SMALL && nsize <= MAX_SMALL && classOf(osize) == classOf(nsize))
+			return ptr;
+
+		void * block = acquire(nsize);
+		if(!block)
+			return nsize < osize && keep(ptr, osize) ? ptr : nullptr;
+		std::memcpy(block, ptr, std::min(osize, nsize));
+		release(ptr, osize);
+		return block;
+	}
+
+private:
+	struct FreeBlock
+	{
+		FreeBlock * next;
+	};
+
+	struct SizeClass
+	{
+		FreeBlock * free;
+		char * cursor;
+		char * limit;
+	};
+
+	static std::size_t classOf(std::size_t size) { return (size - 1) / GRANULE; }
+
+	/**
+	 * Makes room for given number of slabs, without throwing through lua_Alloc
+	 */
+	bool spare(std::size_t count)
+	{
+		if(slabs.capacity() - slabs.size() >= count)
+			return true;
+		try
+		{
+			slabs.reserve(std::max(slabs.capacity() * 2, slabs.size() + count));
+		}
+		catch(const std::bad_alloc &)
+		{
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Keeps block shrunk into smaller size in place
+	 *
+	 * Block of larger size class serves the smaller one as it is. Large block becomes
+	 * block of size class, and is released with slabs.
+	 */
+	bool keep(void * ptr, std::size_t osize)
+	{
+		if(osize <= MAX_SMALL)
+			return true;
+		if(!spare(1))
+			return false;
+		slabs.push_back(ptr);
+		return true;
+	}
+
+	SizeClass classes[MAX_SMALL / GRANULE];
+	std::vector<void *> slabs;
+};
+
+/**
+ * Allocator bumping pointer in chunks, never reusing freed memory
+ *
+ * Meant for short-lived states: allocation is just a pointer increment, freeing
+ * does nothing, and all the memory is released at once when the allocator is
+ * destroyed after its state is closed. As freed memory is not reused, memory limit
+ * is checked against bytes of chunks taken from system.
+ */
+class ArenaAllocator: public impl::AllocatorBase<ArenaAllocator>
+{
+public:
+	static constexpr std::size_t ALIGNMENT = 16;
+
+	/**
+	 * \param chunkSize_ Size of memory chunks taken from system
+	 */
+	ArenaAllocator(std::size_t chunkSize_ = 256 * 1024):
+		chunkSize(chunkSize_),
+		cursor(nullptr),
+		limit(nullptr),
+		last(nullptr)
+	{ }
+
+	ArenaAllocator(const ArenaAllocator &) = delete;
+	ArenaAllocator & operator =(const ArenaAllocator &) = delete;
+
+	~ArenaAllocator()
+	{
+		for(void * chunk: chunks)
+			std::free(chunk);
+	}
+
+	void * acquire(std::size_t size)
+	{
+		size = align(size);
+		if(static_cast<std::size_t>(limit - cursor) < size)
+		{
+			std::size_t newSize = std::max(chunkSize, size);
+			if(byteLimit)
+			{
+				// freed blocks are not reused, so memory limit applies to chunks
+				std::size_t remaining = byteLimit > counters.reservedBytes ? byteLimit - counters.reservedBytes : 0;
+				if(size > remaining)
+				{
+					++counters.rejections;
+					return nullptr;
+				}
+				newSize = std::min(newSize, remaining);
+			}
+			if(!spare())
+				return nullptr;
+			char * chunk = static_cast<char *>(std::malloc(newSize));
+			if(!chunk)
+				return nullptr;
+			chunks.push_back(chunk);
+			counters.reservedBytes += newSize;
+			cursor = chunk;
+			limit = chunk + newSize;
+		}
+
+		last = cursor;
+		cursor += size;
+		return last;
+	}
+
+	void release(void *, std::size_t) { }
+
+	void * resize(void * ptr, std::size_t osize, std::size_t nsize)
+	{
+		if(align(nsize) <= align(osize))
+			return ptr;
+
+		// the most recent block can grow in place
+		if(ptr == last && static_cast<std::size_t>(limit - last) >= align(nsize))
+		{
+			cursor = last + align(nsize);
+			return ptr;
+		}
+
+		void * block = acquire(nsize);
+		if(block)
+			std::memcpy(block, ptr, osize);
+		return block;
+	}
+
+private:
+	static std::size_t align(std::size_t size) { return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; }
+
+	/**
+	 * Makes room for next chunk, without throwing through lua_Alloc
+	 */
+	bool spare()
+	{
+		if(chunks.size() < chunks.capacity())
+			return true;
+		try
+		{
+			chunks.reserve(std::max<std::size_t>(16, chunks.capacity() * 2));
+		}
+		catch(const std::bad_alloc &)
+		{
+			return false;
+		}
+		return true;
+	}
+
+	std::size_t chunkSize;
+	char * cursor;
+	char * limit;
+	char * last;
+	std::vector<void *> chunks;
+};
+
+}
@@ -0,0 +1,63 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "impl/Reference.hpp"
+
+#include <string>
+#include <string_view>
+
+namespace smartlua
+{
+
+/**
+ * String owned by lua and borrowed by C++ code
+ *
+ * Keeps lua string pinned in registry, so the viewed characters stay valid as long as
+ * this object lives, even after the stack slot it was taken from is popped. No copy
+ * of the string contents is ever made, and embedded zeros are preserved.
+ */
+class BorrowedString
+{
+public:
+	BorrowedString():
+		ref(nullptr)
+	{ }
+
+	BorrowedString(std::string_view view_, impl::Reference && ref_):
+		view(view_),
+		ref(std::move(ref_))
+	{ }
+
+	const char * data() const { return view.data(); }
+	std::size_t size() const { return view.size(); }
+	bool empty() const { return view.empty(); }
+
+	std::string_view get() const { return view; }
+	operator std::string_view() const { return view; }
+
+	/**
+	 * \return Copy of borrowed string which doesn't depend on lua state
+	 */
+	std::string str() const { return std::string(view); }
+
+private:
+	std::string_view view;
+	impl::Reference ref;
+};
+
+}
@@ -0,0 +1,125 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "impl/Reference.hpp"
+
+#include <lua.hpp>
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace smartlua
+{
+
+namespace impl
+{
+
+template<class T>
+struct BufferUserdata;
+
+}
+
+/**
+ * Contiguous array of numbers shared between C++ and lua without copying
+ *
+ * In lua buffer is an userdata indexable from 1 like a table, and with its size
+ * available through length operator. Buffer is either a view of memory owned by
+ * C++ code, which has to outlive every use of it in lua, or owns its memory
+ * stored inside of userdata - such buffers are created by allocate. Buffer
+ * extracted from lua keeps its userdata alive.
+ */
+template<class T>
+class Buffer
+{
+	static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+		"Buffer can contain only numbers");
+
+public:
+	Buffer():
+		ptr(nullptr),
+		count(0),
+		ref(nullptr)
+	{ }
+
+	/**
+	 * Creates view of memory owned by C++ code
+	 */
+	Buffer(T * data_, std::size_t size_):
+		ptr(data_),
+		count(size_),
+		ref(nullptr)
+	{ }
+
+	/**
+	 * Creates view of contiguous container
+	 *
+	 * Buffers themselves are excluded, so copies keep reference to their userdata.
+	 */
+	template<class C, class E=typename std::enable_if<
+		!std::is_same<typename std::decay<C>::type, Buffer>::value &&
+		std::is_same<decltype(std::declval<C&>().data()), T *>::value>::type>
+	explicit Buffer(C & container):
+		Buffer(container.data(), container.size())
+	{ }
+
+	Buffer(T * data_, std::size_t size_, impl::Reference && ref_):
+		ptr(data_),
+		count(size_),
+		ref(std::move(ref_))
+	{ }
+
+	/**
+	 * Creates buffer with memory owned by lua userdata
+	 *
+	 * Memory is zero initialized. Stack.hpp has to be included to use this function.
+	 *
+	 * \param size Number of elements in buffer
+	 */
+	static Buffer allocate(lua_State * state, std::size_t size)
+	{
+		return impl::BufferUserdata<T>::allocate(state, size);
+	}
+
+	T * data() const { return ptr; }
+	std::size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	T * begin() const { return ptr; }
+	T * end() const { return ptr + count; }
+
+	T & operator [](std::size_t i) const { return ptr[i]; }
+
+	/**
+	 * \return True if buffer refers to lua userdata, false if it is a view of C++ memory
+	 * not yet pushed to lua
+	 */
+	bool isUserdata() const { return ref; }
+
+	/**
+	 * \return Reference to userdata of buffer
+	 */
+	const impl::Reference & getReference() const { return ref; }
+
+private:
+	T * ptr;
+	std::size_t count;
+	impl::Reference ref;
+};
+
+}
@@ -0,0 +1,86 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "Stack.hpp"
+#include "impl/CFunction.hpp"
+#include "utils/Traits.hpp"
+
+#include <lua.hpp>
+
+#include <type_traits>
+#include <utility>
+
+namespace smartlua
+{
+
+/**
+ * Pushes function known at compile time as lua function
+ *
+ * Arguments are unpacked from lua stack, and result is pushed back with impl::Stack,
+ * tuples are returned as multiple results. Pushed value is plain lua_CFunction
+ * without any upvalues.
+ *
+ * \code
+ * constexpr auto add = [](int a, int b) { return a + b; }; // at namespace scope
+ * smartlua::pushFunction<&foo>(state);
+ * smartlua::pushFunction<+add>(state);
+ * \endcode
+ */
+template<auto F>
+void pushFunction(lua_State * state)
+{
+	lua_CFunction trampoline = &utils::function_traits<decltype(F)>::template
+		apply<impl::CFunction>::template callStatic<F>;
+	lua_pushcfunction(state, trampoline);
+}
+
+/**
+ * Pushes C++ callable as lua function
+ *
+ * Default constructible stateless functors are pushed as plain lua_CFunction,
+ * function pointers and lambdas convertible to them are kept in upvalue, and any
+ * other functors are moved to userdata kept in upvalue.
+ */
+template<class F>
+void pushFunction(lua_State * state, F && f)
+{
+	utils::function_traits<typename std::decay<F>::type>::template
+		apply<impl::CFunction>::push(state, std::forward<F>(f));
+}
+
+/**
+ * Sets function known at compile time as lua global
+ */
+template<auto F>
+void registerFunction(lua_State * state, const char * name)
+{
+	pushFunction<F>(state);
+	lua_setglobal(state, name);
+}
+
+/**
+ * Sets C++ callable as lua global
+ */
+template<class F>
+void registerFunction(lua_State * state, const char * name, F && f)
+{
+	pushFunction(state, std::forward<F>(f));
+	lua_setglobal(state, name);
+}
+
+}
@@ -0,0 +1,185 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "Stack.hpp"
+#include "impl/CallFrame.hpp"
+#include "impl/Class.hpp"
+
+#include <lua.hpp>
+
+#include <type_traits>
+
+namespace smartlua
+{
+
+/**
+ * Exposes C++ class to lua
+ *
+ * Objects of the class are pushed to lua as userdata, and their methods and properties
+ * are available in lua with usual syntax:
+ *
+ * \code
+ * smartlua::Class<Point>(state, "Point")
+ *     .constructor<double, double>()
+ *     .method("length", &Point::length)
+ *     .property("x", &Point::x)
+ *     .finish();
+ * \endcode
+ *
+ * \code
+ * local p = Point.new(3, 4)
+ * p.x = p:length()
+ * \endcode
+ *
+ * Every method and property is a C closure created once, when registered, with member
+ * pointer kept in its upvalue. Method lookup is a single raw get in methods table,
+ * which is itself used as __index if class has no properties. Class table with
+ * all methods is set as global variable with the class name.
+ *
+ * Registration takes effect with finish, which sets metamethods and the global, and
+ * is the last call on the object. Object destroyed without finish registers nothing.
+ * Class can be extended by registering it again.
+ */
+template<class T>
+class Class
+{
+public:
+	Class(lua_State * state_, const char * name_):
+		state(state_),
+		name(name_),
+		frame(state_)
+	{
+		impl::Stack<T>::pushMetatable(state);
+		metatable = lua_gettop(state);
+		methods = table("__methods");
+		getters = table("__getters");
+		setters = table("__setters");
+
+		lua_pushstring(state, name);
+		lua_setfield(state, metatable, "__name");
+	}
+
+	Class(const Class &) = delete;
+	Class & operator =(const Class &) = delete;
+
+	/**
+	 * Finishes registration, making class available in lua
+	 */
+	void finish()
+	{
+		lua_pushvalue(state, methods);
+		if(!empty(getters))
+		{
+			lua_pushvalue(state, getters);
+			lua_pushcclosure(state, &impl::ClassMetamethods::index, 2);
+		}
+		lua_setfield(state, metatable, "__index");
+
+		if(!empty(setters))
+		{
+			lua_pushvalue(state, setters);
+			lua_pushcclosure(state, &impl::ClassMetamethods::newindex, 1);
+			lua_setfield(state, metatable, "__newindex");
+		}
+
+		lua_pushvalue(state, methods);
+		lua_setglobal(state, name);
+	}
+
+	/**
+	 * Registers constructor available in lua as `new` function of class table
+	 */
+	template<class... Args>
+	Class & constructor()
+	{
+		lua_CFunction constructor = &impl::Constructor<T, Args...>::call;
+		lua_pushcfunction(state, constructor);
+		lua_setfield(state, methods, "new");
+		return *this;
+	}
+
+	/**
+	 * Registers member function
+	 */
+	template<class M>
+	Class & method(const char * methodName, M method)
+	{
+		impl::Method<T, M>::push(state, method);
+		lua_setfield(state, methods, methodName);
+		return *this;
+	}
+
+	/**
+	 * Registers data member, const members are read only
+	 *
+	 * Member can belong to base class of T.
+	 */
+	template<class M, class B>
+	Class & property(const char * propertyName, M B::* baseMember)
+	{
+		static_assert(std::is_base_of<B, T>::value, "Property has to be member of class or its base");
+
+		M T::* member = baseMember;
+		impl::Property<T, M>::pushGetter(state, member);
+		lua_setfield(state, getters, propertyName);
+
+		if constexpr(impl::Property<T, M>::writable)
+		{
+			impl::Property<T, M>::pushSetter(state, member);
+			lua_setfield(state, setters, propertyName);
+		}
+		return *this;
+	}
+
+private:
+	/**
+	 * Pushes table kept in metatable, creating it if needed
+	 * \return Stack index of the table
+	 */
+	int table(const char * key)
+	{
+		if(lua_getfield(state, metatable, key) != LUA_TTABLE)
+		{
+			lua_pop(state, 1);
+			lua_newtable(state);
+			lua_pushvalue(state, -1);
+			lua_setfield(state, metatable, key);
+		}
+		return lua_gettop(state);
+	}
+
+	bool empty(int idx)
+	{
+		lua_pushnil(state);
+		if(!lua_next(state, idx))
+			return true;
+
+		lua_pop(state, 2);
+		return false;
+	}
+
+	lua_State * state;
+	const char * name;
+	impl::CallFrame frame;
+	int metatable;
+	int methods;
+	int getters;
+	int setters;
+};
+
+}
@@ -0,0 +1,260 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "Stack.hpp"
+#include "Error.hpp"
+#include "ExecutionLimit.hpp"
+#include "impl/CoroutinePool.hpp"
+#include "impl/ErrorMessage.hpp"
+#include "impl/Function.hpp"
+#include "impl/Reference.hpp"
+
+#include <lua.hpp>
+
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace smartlua
+{
+
+/**
+ * Lua function call running in its own lua thread, which can be suspended
+ *
+ * Call is started immediately and runs until the function yields or returns. While
+ * it's suspended, values passed to yield can be read with get, and the call is
+ * continued with resume, passing values returned by yield in script. This way single
+ * OS thread can keep any number of calls waiting for host, each costing only a lua
+ * thread. Threads are taken from per-state pool and returned to it when the
+ * coroutine is destroyed, so after warm-up starting a call allocates nothing. Limit
+ * set on the function applies to the start and to every resume separately, time
+ * spent suspended is not counted.
+ *
+ * \code
+ * auto call = fetch.start(url);
+ * while(call.suspended())
+ * {
+ *     std::string request;
+ *     call.get(request);
+ *     call.resume(serve(request));
+ * }
+ * call.get(result);
+ * \endcode
+ */
+class Coroutine
+{
+public:
+	enum class Status {SUSPENDED, FINISHED, FAILED};
+
+	template<class... Args>
+	Coroutine(impl::Function & fnc, Args &&... args):
+		state(fnc.getState()),
+		pool(nullptr),
+		entry { nullptr, impl::Reference(fnc.getState()) },
+		subject(fnc.getSubject()),
+		limit(fnc.getLimit()),
+		status(Status::FAILED),
+		code(Error::Code::EMPTY_REFERENCE_USAGE),
+		count(0)
+	{
+		if(!fnc)
+			return;
+
+		pool = impl::CoroutinePool::of(state);
+		if(!pool || !pool->acquire(state, entry))
+		{
+			code = Error::Code::MEMORY_ERROR;
+			return;
+		}
+		fnc.pushOn(entry.thread);
+		run(std::forward<Args>(args)...);
+	}
+
+	Coroutine(const Coroutine &) = delete;
+	Coroutine & operator =(const Coroutine &) = delete;
+
+	Coroutine(Coroutine && other) = default;
+
+	Coroutine & operator =(Coroutine && other)
+	{
+		std::swap(state, other.state);
+		std::swap(pool, other.pool);
+		std::swap(entry, other.entry);
+		std::swap(subject, other.subject);
+		std::swap(limit, other.limit);
+		std::swap(message, other.message);
+		std::swap(status, other.status);
+		std::swap(code, other.code);
+		std::swap(count, other.count);
+		return *this;
+	}
+
+	/**
+	 * Returns thread to pool, suspended call is abandoned
+	 */
+	~Coroutine()
+	{
+		if(entry.ref)
+			pool->release(std::move(entry));
+	}
+
+	Status getStatus() const { return status; }
+	bool suspended() const { return status == Status::SUSPENDED; }
+	bool finished() const { return status == Status::FINISHED; }
+
+	/**
+	 * \return Error which stopped the call
+	 */
+	Error error() const
+	{
+		switch(code)
+		{
+		case Error::Code::OK:
+			return Error::noError();
+		case Error::Code::RUNTIME_ERROR:
+			return Error::runtimeError(message.get()).in(subject.c_str());
+		case Error::Code::MEMORY_ERROR:
+			return Error::memoryError().in(subject.c_str());
+		case Error::Code::TIMEOUT_ERROR:
+			return Error::timeoutError().in(subject.c_str());
+		default:
+			return Error::emptyReferenceUsage("coroutine start").in(subject.c_str());
+		}
+	}
+
+	/**
+	 * \return Number of values yielded by suspended call or returned by finished one
+	 */
+	int size() const { return count; }
+
+	/**
+	 * Extracts value yielded by suspended call or returned by finished one
+	 *
+	 * Values past the last one are nil, as in lua.
+	 *
+	 * \param result[out] Variable to put extracted value
+	 * \param i Position of value, starting from 1
+	 */
+	template<class T>
+	Error get(T & result, int i = 1) const
+	{
+		static_assert(impl::is_extractable<T>::value, "Type cannot be extracted from lua stack");
+
+		if(status == Status::FAILED)
+			return error();
+
+		Error e = Error::noError();
+		if(i >= 1 && i <= count)
+		{
+			e = impl::Stack<T>::safeGet(entry.thread, result, lua_gettop(entry.thread) - count + i);
+		}
+		else
+		{
+			lua_pushnil(entry.thread);
+			e = impl::Stack<T>::safeGet(entry.thread, result, -1);
+			lua_pop(entry.thread, 1);
+		}
+
+		if(!e)
+			return e.during("extracting value", i).in(subject.c_str());
+		return e;
+	}
+
+	/**
+	 * Continues suspended call
+	 *
+	 * \param args Values returned by yield in script
+	 * \return Error if the call failed
+	 */
+	template<class... Args>
+	Error resume(Args &&... args)
+	{
+		if(status != Status::SUSPENDED)
+			return Error::runtimeError("cannot resume non-suspended coroutine").in(subject.c_str());
+
+		lua_pop(entry.thread, count);
+		run(std::forward<Args>(args)...);
+		return error();
+	}
+
+private:
+	template<class... Args>
+	void run(Args &&... args)
+	{
+		lua_checkstack(entry.thread, sizeof...(Args) + 1);
+		(impl::Stack<typename std::decay<Args>::type>::push(entry.thread, std::forward<Args>(args)), ...);
+
+		count = 0;
+		int result;
+		if(limit)
+		{
+			impl::LimitHook hook(state, entry.thread, limit);
+			if(!hook.isInstalled())
+			{
+				fail(Error::Code::MEMORY_ERROR);
+				return;
+			}
+			result = lua_resume(entry.thread, state, sizeof...(Args), &count);
+			if(hook.isExceeded())
+			{
+				fail(Error::Code::TIMEOUT_ERROR);
+				return;
+			}
+		}
+		else
+		{
+			result = lua_resume(entry.thread, state, sizeof...(Args), &count);
+		}
+
+		if(result == LUA_OK || result == LUA_YIELD)
+		{
+			status = result == LUA_OK ? Status::FINISHED : Status::SUSPENDED;
+			code = Error::Code::OK;
+		}
+		else if(result == LUA_ERRMEM)
+		{
+			fail(Error::Code::MEMORY_ERROR);
+		}
+		else
+		{
+			status = Status::FAILED;
+			code = Error::Code::RUNTIME_ERROR;
+			message.pin(entry.thread, -1);
+			count = 0;
+		}
+	}
+
+	void fail(Error::Code code_)
+	{
+		status = Status::FAILED;
+		code = code_;
+		count = 0;
+	}
+
+	lua_State * state;
+	impl::CoroutinePool * pool;
+	impl::CoroutinePool::Entry entry;
+	std::string subject;
+	ExecutionLimit limit;
+	impl::ErrorMessage message;
+	Status status;
+	Error::Code code;
+	int count;
+};
+
+}
@@ -16,11 +16,28 @@
 
 #pragma once
 
+#include <lua.hpp>
+
+#include <algorithm>
 #include <string>
+#include <type_traits>
 
 namespace smartlua
 {
 
+/**
+ * Result of operation on lua state
+ *
+ * Error is small, trivially copyable record of error code and its context, so
+ * creating, returning and copying it never allocates. All strings it refers to are
+ * either static, or owned by the object which reported the error, like name of
+ * the function or runtime error message, valid until next failed call of the same
+ * handle. Readable message is built only when requested with message().
+ *
+ * Type mismatches are described by lua type ids of expected and found values, and
+ * by path to mismatched value within extracted containers, like
+ * `iterable[3].tuple[2]`.
+ */
 struct Error
 {
 	enum class Code
@@ -29,58 +46,211 @@ struct Error
 		BAD_REFERENCE_TYPE,
 		EMPTY_REFERENCE_USAGE,
 		RUNTIME_ERROR,
-		STACK_ERROR
+		STACK_ERROR,
+		MEMORY_ERROR,
+		TIMEOUT_ERROR
 	} code;
 
-	std::string desc;
+	/**
+	 * Type id of integer numbers, to distinguish them from other lua numbers
+	 */
+	static constexpr int TINTEGER = 64;
+
+	/**
+	 * Kind of container step in path to mismatched value
+	 */
+	enum class Step: unsigned char
+	{
+		ITERABLE,
+		ITERABLE_KEY,
+		ITERABLE_VALUE,
+		TUPLE,
+		ARRAY
+	};
+
+	/**
+	 * Maximal number of steps kept in path, outermost steps above it are dropped
+	 */
+	static constexpr int PATH_LENGTH = 4;
+
+	struct PathStep
+	{
+		Step step;
+		int index;
+	};
+
+	/** What reported the error, like function name, or nullptr */
+	const char * subject;
+	/** What was done while error occured, or nullptr */
+	const char * operation;
+	/** Position of processed value, like result number, or 0 */
+	int index;
+	/** Expected lua type id on type mismatch, or LUA_TNONE */
+	int expected;
+	/** Found lua type id on type mismatch, or LUA_TNONE */
+	int found;
+	/** Additional description, like lua error message, or nullptr */
+	const char * detail;
+	/** Steps to mismatched value, from the innermost one */
+	PathStep path[PATH_LENGTH];
+	/** Number of steps, including dropped ones */
+	int pathLength;
 
 	operator bool() const { return code == Code::OK; }
 
-	static Error noError() { return Error { Code::OK, "" }; }
+	/**
+	 * Builds readable description of error
+	 */
+	std::string message() const
+	{
+		static const char * const descriptions[] = {
+			"no error",
+			"bad reference type",
+			"empty reference usage",
+			"runtime error",
+			"stack error",
+			"memory error",
+			"timeout error"
+		};
+		static const char * const stepNames[] = {
+			"iterable",
+			"iterable key",
+			"iterable value",
+			"tuple",
+			"array"
+		};
+
+		std::string result;
+		if(subject)
+			result.append(subject).append(": ");
+		result.append(descriptions[static_cast<int>(code)]);
+		if(operation)
+		{
+			result.append(" while ").append(operation);
+			if(index)
+				result.append(" ").append(std::to_string(index));
+		}
+		if(pathLength)
+		{
+			int steps = std::min(pathLength, PATH_LENGTH);
+			result.append(pathLength > PATH_LENGTH ? " at ..." : " at ");
+			for(int i = steps - 1; i >= 0; --i)
+			{
+				if(i != steps - 1)
+					result.append(".");
+				result.append(stepNames[static_cast<int>(path[i].step)]);
+				if(path[i].step != Step::ITERABLE_KEY && path[i].step != Step::ITERABLE_VALUE)
+					result.append("[").append(std::to_string(path[i].index)).append("]");
+			}
+		}
+		if(expected != LUA_TNONE)
+			result.append(" (expected ").append(typeName(expected))
+				.append(", ").append(typeName(found)).append(" found)");
+		if(detail)
+			result.append(" (").append(detail).append(")");
+		return result;
+	}
+
+	/**
+	 * \return Copy of error with subject set
+	 */
+	Error in(const char * subject_) const
+	{
+		Error result = *this;
+		result.subject = subject_;
+		return result;
+	}
 
-	static Error badReference(const std::string & expected, const std::string & found)
+	/**
+	 * \return Copy of error with operation and index of processed value set
+	 */
+	Error during(const char * operation_, int index_ = 0) const
 	{
-		return Error { Code::BAD_REFERENCE_TYPE, "bad reference type: expected " + expected + ", " + found + " found" };
+		Error result = *this;
+		result.operation = operation_;
+		result.index = index_;
+		return result;
 	}
-	static Error badReference(const std::string & prefix, const std::string & expected, const std::string & found)
+
+	/**
+	 * \return Copy of error with container step prepended to path
+	 */
+	Error at(Step step, int index_ = 0) const
 	{
-		return Error { Code::BAD_REFERENCE_TYPE, prefix + ": bad reference type: expected " + expected + ", " + found + " found" };
+		Error result = *this;
+		if(result.pathLength < PATH_LENGTH)
+			result.path[result.pathLength] = PathStep { step, index_ };
+		++result.pathLength;
+		return result;
 	}
 
-	static Error emptyReferenceUsage()
+	/**
+	 * \return Name of lua type id, or of TINTEGER
+	 */
+	static const char * typeName(int type)
 	{
-		return Error { Code::EMPTY_REFERENCE_USAGE, "empty reference usage" };
+		static const char * const names[] = {
+			"no value",
+			"nil",
+			"boolean",
+			"light userdata",
+			"number",
+			"string",
+			"table",
+			"function",
+			"userdata",
+			"thread"
+		};
+
+		if(type == TINTEGER)
+			return "integer";
+		if(type < LUA_TNONE || type > LUA_TTHREAD)
+			return "unknown";
+		return names[type + 1];
 	}
-	static Error emptyReferenceUsage(const std::string & purpose)
+
+	static constexpr Error noError()
 	{
-		return Error { Code::EMPTY_REFERENCE_USAGE, "empty reference usage (" + purpose + ")" };
+		return Error { Code::OK, nullptr, nullptr, 0, LUA_TNONE, LUA_TNONE, nullptr, { }, 0 };
 	}
-	static Error emptyReferenceUsage(const std::string & prefix, const std::string & purpose)
+
+	static constexpr Error badReference(int expected, int found)
 	{
-		return Error { Code::EMPTY_REFERENCE_USAGE, prefix + ": empty reference usage (" + purpose + ")" };
+		return Error { Code::BAD_REFERENCE_TYPE, nullptr, nullptr, 0, expected, found, nullptr, { }, 0 };
 	}
 
-	static Error runtimeError(const std::string & error)
+	static constexpr Error emptyReferenceUsage(const char * purpose)
 	{
-		return Error { Code::RUNTIME_ERROR, "runtime error (" + error + ")" };
+		return Error { Code::EMPTY_REFERENCE_USAGE, nullptr, purpose, 0, LUA_TNONE, LUA_TNONE, nullptr, { }, 0 };
 	}
-	static Error runtimeError(const std::string & prefix, const std::string & error)
+
+	static constexpr Error runtimeError(const char * error)
 	{
-		return Error { Code::RUNTIME_ERROR, prefix + ": runtime error (" + error + ")" };
+		return Error { Code::RUNTIME_ERROR, nullptr, nullptr, 0, LUA_TNONE, LUA_TNONE, error, { }, 0 };
 	}
 
-	static Error stackError(const std::string & error)
+	static constexpr Error stackError(int expected, int found)
 	{
-		return Error { Code::STACK_ERROR, "stack error (" + error + ")" };
+		return Error { Code::STACK_ERROR, nullptr, nullptr, 0, expected, found, nullptr, { }, 0 };
 	}
-	static Error stackError(const std::string & prefix, const std::string & error)
+
+	/**
+	 * Allocation failed, like when memory limit of state was exceeded
+	 */
+	static constexpr Error memoryError()
 	{
-		return Error { Code::STACK_ERROR, prefix + ": stack error (" + error + ")" };
+		return Error { Code::MEMORY_ERROR, nullptr, nullptr, 0, LUA_TNONE, LUA_TNONE, nullptr, { }, 0 };
 	}
-	static Error stackError(const std::string & prefix, const std::string & when, const std::string & error)
+
+	/**
+	 * Call was aborted after exceeding its execution limit
+	 */
+	static constexpr Error timeoutError()
 	{
-		return Error { Code::STACK_ERROR, prefix + ": stack error while " + when + " (" + error + ")" };
+		return Error { Code::TIMEOUT_ERROR, nullptr, nullptr, 0, LUA_TNONE, LUA_TNONE, nullptr, { }, 0 };
 	}
 };
 
+static_assert(std::is_trivially_copyable<Error>::value, "Error has to be trivially copyable");
+
 }
@@ -0,0 +1,296 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#pragma once
+
+#include <lua.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+
+namespace smartlua
+{
+
+/**
+ * Budget of single function call
+ *
+ * Call exceeding any of the limits is aborted and reported as
+ * Error::Code::TIMEOUT_ERROR. Functions without limit run without any hook.
+ */
+struct ExecutionLimit
+{
+	/// Number of lua instructions the call may execute, 0 for no limit
+	std::size_t instructions = 0;
+	/// Wall-clock time the call may take, zero for no limit
+	std::chrono::steady_clock::duration time = std::chrono::steady_clock::duration::zero();
+
+	explicit operator bool() const { return instructions || time.count(); }
+};
+
+namespace impl
+{
+
+/**
+ * Count hook enforcing execution limit while it lives
+ *
+ * Hook of the thread is replaced only for the time of the call, and the previous one
+ * is restored afterwards, so limited calls may be nested. Nested call is checked
+ * against limits of all calls it runs within, so it can't extend budget of outer
+ * call. With time limit clock is read every CLOCK_STEP instructions, which is also
+ * the precision of instruction limit in such case. Once the limit is exceeded, error
+ * is raised on every following instruction, so script catching it with pcall is
+ * aborted anyway.
+ *
+ * Active limit is kept in userdata created in registry on first limited call, so
+ * following calls only update it and never raise errors outside of the call.
+ * Threads created by script inherit the hook. Those the hook ran on get their hook
+ * restored when the call ends, the others switch to hook of the main thread when
+ * the inherited one runs next time.
+ */
+class LimitHook
+{
+public:
+	static constexpr std::size_t CLOCK_STEP = 1000;
+
+	LimitHook(const LimitHook &) = delete;
+	LimitHook & operator =(const LimitHook &) = delete;
+
+	LimitHook(lua_State * state_, const ExecutionLimit & limit_):
+		LimitHook(state_, state_, limit_)
+	{ }
+
+	/**
+	 * \param state_ Thread of the state able to make calls, used to access registry
+	 * \param thread_ Thread running the limited call, like suspended coroutine
+	 */
+	LimitHook(lua_State * state_, lua_State * thread_, const ExecutionLimit & limit_):
+		state(state_),
+		thread(thread_),
+		limit(limit_),
+		deadline(std::chrono::steady_clock::now() + limit_.time),
+		step(limit_.instructions ? limit_.instructions : CLOCK_STEP),
+		executed(0),
+		exceeded(false),
+		slot(find(state_)),
+		outer(nullptr),
+		previousHook(lua_gethook(thread_)),
+		previousMask(lua_gethookmask(thread_)),
+		previousCount(lua_gethookcount(thread_))
+	{
+		if(!slot)
+			return;
+
+		if(limit.time.count())
+			step = std::min(step, CLOCK_STEP);
+		step = std::min<std::size_t>(step, INT_MAX);
+
+		outer = slot->active;
+		if(outer)
+			step = std::min(step, outer->step);
+
+		slot->active = this;
+		lua_sethook(thread, &hook, LUA_MASKCOUNT, static_cast<int>(step));
+	}
+
+	~LimitHook()
+	{
+		if(!slot)
+			return;
+
+		// outer call which ran out of budget within this one is aborted right away
+		int count = outer && outer->exceeded ? 1 : previousCount;
+		lua_sethook(thread, previousHook, previousMask, count);
+		restoreThreads(count);
+		slot->active = outer;
+	}
+
+	/**
+	 * \return If hook is installed, false if registry slot could not be allocated
+	 */
+	bool isInstalled() const { return slot; }
+
+	/**
+	 * \return If call was aborted because of the limit
+	 */
+	bool isExceeded() const { return exceeded; }
+
+private:
+	/**
+	 * Limit active in the state, with table of other threads the hook ran on as its
+	 * user value
+	 */
+	struct Slot
+	{
+		LimitHook * active;
+	};
+
+	/**
+	 * \return Slot of the state, created if missing, nullptr if it could not be
+	 */
+	static Slot * find(lua_State * state)
+	{
+		if(!lua_checkstack(state, 2))
+			return nullptr;
+
+		Slot * slot = nullptr;
+		if(lua_rawgetp(state, LUA_REGISTRYINDEX, &key) == LUA_TUSERDATA)
+		{
+			slot = static_cast<Slot *>(lua_touserdata(state, -1));
+		}
+		else
+		{
+			lua_pop(state, 1);
+			lua_pushcfunction(state, &create);
+			if(lua_pcall(state, 0, 1, 0) == LUA_OK)
+				slot = static_cast<Slot *>(lua_touserdata(state, -1));
+		}
+		lua_pop(state, 1);
+		return slot;
+	}
+
+	static int create(lua_State * state)
+	{
+		auto slot = static_cast<Slot *>(lua_newuserdatauv(state, sizeof(Slot), 1));
+		slot->active = nullptr;
+		lua_newtable(state);
+		lua_setiuservalue(state, -2, 1);
+		lua_pushvalue(state, -1);
+		lua_rawsetp(state, LUA_REGISTRYINDEX, &key);
+		return 1;
+	}
+
+	/**
+	 * Restores hooks of threads created by script, which inherited the hook
+	 *
+	 * Threads are forgotten once the outermost limited call ends. If stack of the
+	 * state can't grow, they are restored when their hook runs next time.
+	 */
+	void restoreThreads(int count)
+	{
+		if(!lua_checkstack(state, 5))
+			return;
+
+		lua_rawgetp(state, LUA_REGISTRYINDEX, &key);
+		lua_getiuservalue(state, -1, 1);
+		lua_pushnil(state);
+		while(lua_next(state, -2))
+		{
+			lua_pop(state, 1);
+			lua_State * other = lua_tothread(state, -1);
+			if(lua_gethook(other) == &hook)
+				lua_sethook(other, previousHook, previousMask, count);
+			if(!outer)
+			{
+				lua_pushvalue(state, -1);
+				lua_pushnil(state);
+				lua_rawset(state, -4);
+			}
+		}
+		lua_pop(state, 2);
+	}
+
+	/**
+	 * Threads created by script inherit the hook, and may outlive the call, so the
+	 * active limit is looked up in registry instead of being bound to the hook
+	 */
+	static void hook(lua_State * thread, lua_Debug *)
+	{
+		lua_rawgetp(thread, LUA_REGISTRYINDEX, &key);
+		auto slot = static_cast<Slot *>(lua_touserdata(thread, -1));
+		LimitHook * self = slot ? slot->active : nullptr;
+		if(!self)
+		{
+			lua_pop(thread, 1);
+			inherit(thread);
+			return;
+		}
+
+		if(thread != self->thread)
+		{
+			// remembered, so the hook is restored when the call ends
+			lua_getiuservalue(thread, -1, 1);
+			lua_pushthread(thread);
+			if(lua_rawget(thread, -2) == LUA_TNIL)
+			{
+				lua_pushthread(thread);
+				lua_pushboolean(thread, 1);
+				lua_rawset(thread, -4);
+			}
+			lua_pop(thread, 2);
+		}
+		lua_pop(thread, 1);
+
+		if(!self->exceeded)
+		{
+			auto now = std::chrono::steady_clock::now();
+			for(LimitHook * hook = self; hook; hook = hook->outer)
+			{
+				hook->executed += self->step;
+				hook->exceeded = hook->exceeded || hook->isOver(now);
+				self->exceeded = self->exceeded || hook->exceeded;
+			}
+			if(!self->exceeded)
+				return;
+		}
+
+		lua_sethook(thread, &hook, LUA_MASKCOUNT, 1);
+		lua_pushliteral(thread, "execution limit exceeded");
+		lua_error(thread);
+	}
+
+	/**
+	 * Gives thread which outlived the limited call hook of the main thread, as if it
+	 * inherited it without the limit
+	 */
+	static void inherit(lua_State * thread)
+	{
+		lua_rawgeti(thread, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+		lua_State * main = lua_tothread(thread, -1);
+		lua_pop(thread, 1);
+		if(main && main != thread && lua_gethook(main) != &hook)
+			lua_sethook(thread, lua_gethook(main), lua_gethookmask(main), lua_gethookcount(main));
+		else
+			lua_sethook(thread, nullptr, 0, 0);
+	}
+
+	bool isOver(std::chrono::steady_clock::time_point now) const
+	{
+		return (limit.instructions && executed >= limit.instructions) ||
+			(limit.time.count() && now >= deadline);
+	}
+
+	lua_State * state;
+	lua_State * thread;
+	ExecutionLimit limit;
+	std::chrono::steady_clock::time_point deadline;
+	std::size_t step;
+	std::size_t executed;
+	bool exceeded;
+	Slot * slot;
+	LimitHook * outer;
+	lua_Hook previousHook;
+	int previousMask;
+	int previousCount;
+
+	static inline const char key = 0;
+};
+
+}
+
+}
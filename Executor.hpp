@@ -0,0 +1,338 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "Error.hpp"
+#include "ExecutionLimit.hpp"
+#include "Function.hpp"
+#include "StatePool.hpp"
+#include "impl/FunctionCache.hpp"
+#include "impl/WorkQueue.hpp"
+#include "utils/Traits.hpp"
+
+#include <lua.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace smartlua
+{
+
+/**
+ * Outcome of function call executed by Executor
+ *
+ * Unlike Error, which points to strings owned by the function handle, message is
+ * owned, so result can be safely passed to other threads.
+ */
+template<class R>
+struct Result
+{
+	R value;
+	Error::Code code;
+	std::string message;
+
+	operator bool() const { return code == Error::Code::OK; }
+};
+
+template<>
+struct Result<void>
+{
+	Error::Code code;
+	std::string message;
+
+	operator bool() const { return code == Error::Code::OK; }
+};
+
+/**
+ * Runs lua function calls on all states of a pool
+ *
+ * Every state gets its own worker thread, keeping the state checked out for the
+ * executor lifetime. Submitted calls are spread over workers, and workers which run
+ * out of calls steal them from others, so a single slow call doesn't hold calls
+ * queued behind it. Queues are lock-free; mutex is used only to put idle workers to
+ * sleep. Pending calls are finished before the executor is destroyed. Each worker
+ * looks a function up in its state on the first call only, like PoolFunction.
+ *
+ * Exceptions thrown while running a call, like by conversion of its arguments, are
+ * reported as runtime errors in its result.
+ *
+ * Executor of pool which failed to be created, or has no states, starts no workers,
+ * and fails every submitted call with error(). Calls exceeding limit given to the
+ * executor fail with Error::Code::TIMEOUT_ERROR, so stuck script doesn't take its
+ * worker forever.
+ */
+class Executor
+{
+public:
+	/**
+	 * \param limit Budget of every call, empty to run calls without hook
+	 */
+	Executor(StatePool & pool, const ExecutionLimit & limit_ = ExecutionLimit()):
+		lastError(check(pool)),
+		limit(limit_),
+		pending(0),
+		sleeping(0),
+		next(0),
+		stopping(false),
+		workers(lastError ? pool.size() : 0)
+	{
+		for(std::size_t i = 0; i < workers.size(); ++i)
+			workers[i].thread = std::thread(&Executor::work, this, std::ref(pool), i);
+	}
+
+	Executor(const Executor &) = delete;
+	Executor & operator =(const Executor &) = delete;
+
+	~Executor()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for(auto & worker: workers)
+			worker.thread.join();
+	}
+
+	/**
+	 * Submits call of global function
+	 *
+	 * \param R Result type, as for Function
+	 * \param name Name of global function
+	 * \param args Arguments of the call, copied to be used by worker
+	 * \return Future result of the call
+	 */
+	template<class R, class... Args>
+	auto submit(const std::string & name, Args &&... args)
+	{
+		auto task = new Call<R, typename std::decay<Args>::type...>(name, std::forward<Args>(args)...);
+		auto result = task->promise.get_future();
+		if(workers.empty())
+		{
+			task->fail(lastError);
+			delete task;
+			return result;
+		}
+
+		auto & worker = workers[next.fetch_add(1, std::memory_order_relaxed) % workers.size()];
+		worker.inbox.push(task);
+		pending.fetch_add(1, std::memory_order_seq_cst);
+
+		if(sleeping.load(std::memory_order_seq_cst))
+		{
+			{ std::lock_guard<std::mutex> lock(mutex); }
+			wake.notify_one();
+		}
+
+		return result;
+	}
+
+	/**
+	 * \return Error of the pool, if executor couldn't start
+	 */
+	Error error() const { return lastError; }
+
+	std::size_t size() const { return workers.size(); }
+
+private:
+	template<class R, class... Args>
+	class Call: public impl::Task
+	{
+	public:
+		typedef decltype(std::apply(std::declval<Function<R> &>(), std::declval<std::tuple<Args...> &>())) Value;
+
+		static_assert(!utils::is_stack_bound_type<Value>::value,
+			"Result would point to string of worker state, use std::string");
+
+		template<class... Params>
+		Call(const std::string & name_, Params &&... params):
+			name(name_),
+			args(std::forward<Params>(params)...)
+		{ }
+
+		void run(lua_State *, impl::FunctionCache & functions) override
+		{
+			auto & function = functions.get<R>(name);
+			if constexpr (std::is_void<Value>::value)
+			{
+				std::apply(function, args);
+				promise.set_value(makeResult(function.error()));
+			}
+			else
+			{
+				auto value = std::apply(function, args);
+				auto outcome = makeResult(function.error());
+				outcome.value = std::move(value);
+				promise.set_value(std::move(outcome));
+			}
+		}
+
+		void fail(Error error)
+		{
+			promise.set_value(makeResult(error));
+		}
+
+		void abort(const char * message) override
+		{
+			try
+			{
+				std::string subject = "function " + name;
+				fail(Error::runtimeError(message).in(subject.c_str()));
+			}
+			catch(...)
+			{
+				// result was set before the exception, or there is no memory to set it,
+				// then the future reports broken promise once the task is deleted
+			}
+		}
+
+		std::promise<Result<Value>> promise;
+
+	private:
+		static Result<Value> makeResult(Error error)
+		{
+			Result<Value> outcome{};
+			outcome.code = error.code;
+			if(!error)
+				outcome.message = error.message();
+			return outcome;
+		}
+
+		std::string name;
+		std::tuple<Args...> args;
+	};
+
+	static Error check(const StatePool & pool)
+	{
+		if(!pool)
+			return pool.error();
+		if(pool.size() == 0)
+			return Error::emptyReferenceUsage("executor start").in("state pool");
+		return Error::noError();
+	}
+
+	struct Worker
+	{
+		std::thread thread;
+		impl::TaskInbox inbox;
+		impl::WorkDeque deque;
+	};
+
+	void work(StatePool & pool, std::size_t self)
+	{
+		auto lease = pool.checkout();
+		impl::FunctionCache functions(lease, limit);
+		auto & deque = workers[self].deque;
+
+		while(true)
+		{
+			impl::Task * task = find(self);
+			if(task)
+			{
+				pending.fetch_sub(1, std::memory_order_relaxed);
+				try
+				{
+					task->run(lease, functions);
+				}
+				catch(std::exception & e)
+				{
+					task->abort(e.what());
+				}
+				catch(...)
+				{
+					task->abort("unknown C++ exception");
+				}
+				lua_settop(lease, 0);
+				delete task;
+				continue;
+			}
+
+			if(pending.load(std::memory_order_seq_cst))
+			{
+				// task is already queued, but not yet visible in any queue
+				std::this_thread::yield();
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(mutex);
+			sleeping.fetch_add(1, std::memory_order_seq_cst);
+			wake.wait(lock, [&] { return pending.load(std::memory_order_seq_cst) || stopping; });
+			sleeping.fetch_sub(1, std::memory_order_seq_cst);
+			if(stopping && !pending.load(std::memory_order_seq_cst))
+				break;
+		}
+
+		while(impl::Task * task = deque.take())
+			delete task;
+	}
+
+	/**
+	 * Finds task in own queues first, then in queues of other workers
+	 */
+	impl::Task * find(std::size_t self)
+	{
+		auto & deque = workers[self].deque;
+		if(impl::Task * task = deque.take())
+			return task;
+
+		for(std::size_t i = 0; i < workers.size(); ++i)
+		{
+			auto & victim = workers[(self + i) % workers.size()];
+			if(impl::Task * task = victim.inbox.takeAll())
+			{
+				for(impl::Task * other = impl::TaskInbox::next(task); other; )
+				{
+					impl::Task * following = impl::TaskInbox::next(other);
+					deque.push(other);
+					other = following;
+				}
+				return task;
+			}
+
+			if(i != 0)
+			{
+				if(impl::Task * task = victim.deque.steal())
+					return task;
+			}
+		}
+		return nullptr;
+	}
+
+	Error lastError;
+	ExecutionLimit limit;
+	std::atomic<std::size_t> pending;
+	std::atomic<std::size_t> sleeping;
+	std::atomic<std::size_t> next;
+	bool stopping;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<Worker> workers;
+};
+
+}
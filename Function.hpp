@@ -18,9 +18,16 @@
 
 #include "Stack.hpp"
 #include "Error.hpp"
+#include "Coroutine.hpp"
+#include "ExecutionLimit.hpp"
+#include "impl/CallFrame.hpp"
+#include "impl/CallSite.hpp"
 #include "impl/Function.hpp"
+#include "utils/Traits.hpp"
 
 #include <string>
+#include <iterator>
+#include <type_traits>
 
 namespace smartlua
 {
@@ -31,42 +38,128 @@ namespace smartlua
 template<class R>
 class Function
 {
+	static_assert(impl::is_extractable<R>::value, "Function result cannot be extracted from lua stack");
+	static_assert(!utils::is_stack_bound_type<R>::value,
+		"Function result would point to popped lua string, use BorrowedString or std::string");
+
 public:
 	Function(impl::Reference && ref, const std::string & name = "__UNKNOWN_FUNCTION__"):
 		lastError(Error::noError()),
 		fnc(std::move(ref), name, lastError)
 	{ }
 
-	Error error(){ return lastError; }
+	Error error() const { return fnc.own(lastError); }
 	operator bool() const { return fnc; }
 
+	/**
+	 * Limits instructions or time of following calls and coroutines started, aborting
+	 * them with Error::Code::TIMEOUT_ERROR, like when script is stuck in endless loop
+	 */
+	void setLimit(const ExecutionLimit & limit) { fnc.setLimit(limit); }
+
+	/**
+	 * Keeps function on the stack for calls made until returned scope ends
+	 *
+	 * Calls within the scope skip registry lookup, which pays off when the function is
+	 * called in a tight loop.
+	 */
+	impl::CallSite bind() { return impl::CallSite(fnc); }
+
+	/**
+	 * Starts call in new lua thread, which can be suspended by yield in script
+	 */
+	template<class... Args>
+	Coroutine start(Args &&... args) { return Coroutine(fnc, std::forward<Args>(args)...); }
+
 	template<class... Args>
-	R operator()(Args... args)
+	R operator()(Args &&... args)
 	{
-		lua_State * state;
-		std::tie(state, lastError) = fnc(1, args...);
-		Stack stack(state);
-		if(!lastError)
+		R result{};
+		call(result, std::forward<Args>(args)...);
+		return result;
+	}
+
+	/**
+	 * Calls function extracting its result into existing object
+	 *
+	 * Containers are refilled in place, so storage preallocated for a column of values
+	 * is reused instead of allocating new one on every call.
+	 *
+	 * \param result[out] Object to extract result to
+	 * \return Error of the call, also returned by error() until next call
+	 */
+	template<class... Args>
+	Error call(R & result, Args &&... args)
+	{
+		impl::CallFrame frame(fnc.getState());
+		lastError = fnc(frame, 1, std::forward<Args>(args)...);
+		extract(frame, result);
+		return lastError;
+	}
+
+	/**
+	 * Calls function for every element of range and stores results
+	 *
+	 * Elements being tuples are unpacked into separate arguments. Function is kept on
+	 * the stack for the whole batch, and it stops on first failed call, which error is
+	 * then returned by error().
+	 *
+	 * \param range Arguments of consecutive calls
+	 * \param out Iterator to store results to
+	 * \return Iterator past the last stored result
+	 */
+	template<class Range, class OutputIt>
+	OutputIt map(const Range & range, OutputIt out)
+	{
+		auto site = bind();
+		fnc.template reserve<typename std::decay<decltype(*std::begin(range))>::type>();
+		for(auto && item: range)
 		{
-			stack.size(0);
-			return R();
+			impl::CallFrame frame(fnc.getState());
+			lastError = fnc.callWith(frame, 1, item);
+			R result{};
+			extract(frame, result);
+			if(!lastError)
+				break;
+			*out++ = std::move(result);
 		}
+		return out;
+	}
 
-		R result;
-		lastError = stack.safeGet(result);
-		if(!lastError)
-			lastError = Error::stackError(
-				"function " + fnc.getName(),
-				"extracting result",
-				lastError.desc);
-		else
-			lastError = Error::noError();
-
-		stack.size(0);
-		return result;
+	/**
+	 * Calls function for every element of range, discarding results
+	 *
+	 * \param range Arguments of consecutive calls
+	 * \return Number of successful calls
+	 */
+	template<class Range>
+	std::size_t forEach(const Range & range)
+	{
+		auto site = bind();
+		fnc.template reserve<typename std::decay<decltype(*std::begin(range))>::type>();
+		std::size_t count = 0;
+		for(auto && item: range)
+		{
+			impl::CallFrame frame(fnc.getState());
+			lastError = fnc.callWith(frame, 0, item);
+			if(!lastError)
+				break;
+			++count;
+		}
+		return count;
 	}
 
 private:
+	void extract(impl::CallFrame & frame, R & result)
+	{
+		if(!lastError)
+			return;
+
+		lastError = impl::Stack<R>::safeGet(frame.getState(), result, frame.index(1));
+		if(!lastError)
+			lastError = lastError.during("extracting result").in(fnc.getSubject());
+	}
+
 	Error lastError;
 	impl::Function fnc;
 };
@@ -80,15 +173,61 @@ public:
 		fnc(std::move(ref), name, lastError)
 	{ }
 
-	Error error() const { return lastError; }
+	Error error() const { return fnc.own(lastError); }
 	operator bool() const { return fnc; }
 
+	/**
+	 * Limits instructions or time of following calls and coroutines started, aborting
+	 * them with Error::Code::TIMEOUT_ERROR, like when script is stuck in endless loop
+	 */
+	void setLimit(const ExecutionLimit & limit) { fnc.setLimit(limit); }
+
+	/**
+	 * Keeps function on the stack for calls made until returned scope ends
+	 *
+	 * Calls within the scope skip registry lookup, which pays off when the function is
+	 * called in a tight loop.
+	 */
+	impl::CallSite bind() { return impl::CallSite(fnc); }
+
+	/**
+	 * Starts call in new lua thread, which can be suspended by yield in script
+	 */
+	template<class... Args>
+	Coroutine start(Args &&... args) { return Coroutine(fnc, std::forward<Args>(args)...); }
+
 	template<class... Args>
-	void operator()(Args... args)
+	void operator()(Args &&... args)
+	{
+		impl::CallFrame frame(fnc.getState());
+		lastError = fnc(frame, 0, std::forward<Args>(args)...);
+	}
+
+	/**
+	 * Calls function for every element of range
+	 *
+	 * Elements being tuples are unpacked into separate arguments. Function is kept on
+	 * the stack for the whole batch, and it stops on first failed call, which error is
+	 * then returned by error().
+	 *
+	 * \param range Arguments of consecutive calls
+	 * \return Number of successful calls
+	 */
+	template<class Range>
+	std::size_t forEach(const Range & range)
 	{
-		lua_State * state;
-		std::tie(state, lastError) = fnc(0, args...);
-		Stack(state).size(0);
+		auto site = bind();
+		fnc.template reserve<typename std::decay<decltype(*std::begin(range))>::type>();
+		std::size_t count = 0;
+		for(auto && item: range)
+		{
+			impl::CallFrame frame(fnc.getState());
+			lastError = fnc.callWith(frame, 0, item);
+			if(!lastError)
+				break;
+			++count;
+		}
+		return count;
 	}
 
 private:
@@ -18,11 +18,11 @@
 
 #include "Function.hpp"
 #include "Error.hpp"
-
-#include <boost/format.hpp>
+#include "utils/Traits.hpp"
 
 #include <vector>
 #include <tuple>
+#include <utility>
 
 namespace smartlua
 {
@@ -33,26 +33,20 @@ namespace impl
 template<int N, class Tuple>
 struct ExtractResults
 {
-	static Error get(lua_State * state, Tuple & result, const std::string & name)
+	static Error get(lua_State * state, Tuple & result, int base)
 	{
-		smartlua::Stack stack(state);
-		auto e = stack.safeGet(std::get<N-1>(result), N);
+		auto e = Stack<typename std::tuple_element<N-1, Tuple>::type>::safeGet(state, std::get<N-1>(result), base + N);
 		if(!e)
-		{
-			return Error::stackError(
-				"function " + name,
-				(boost::format("extracting result %1%") % N).str(),
-				e.desc);
-		}
+			return e.during("extracting result", N);
 
-		return ExtractResults<N-1, Tuple>::get(state, result, name);
+		return ExtractResults<N-1, Tuple>::get(state, result, base);
 	}
 };
 
 template<class Tuple>
 struct ExtractResults<0, Tuple>
 {
-	static Error get(lua_State *, Tuple &, const std::string &) { return Error::noError(); }
+	static Error get(lua_State *, Tuple &, int) { return Error::noError(); }
 };
 
 }
@@ -66,45 +60,82 @@ struct MultiReturn { };
 template<class R>
 class Function<MultiReturn<R>>
 {
+	static_assert(impl::is_extractable<R>::value, "Function result cannot be extracted from lua stack");
+	static_assert(!utils::is_stack_bound_type<R>::value,
+		"Function result would point to popped lua string, use BorrowedString or std::string");
+
 public:
 	Function(impl::Reference && ref, const std::string & name = "__UNKNOWN_FUNCTION__"):
 		lastError(Error::noError()),
 		fnc(std::move(ref), name, lastError)
 	{ }
 
-	Error error() { return lastError; }
+	Error error() const { return fnc.own(lastError); }
 	operator bool() const { return fnc; }
 
+	/**
+	 * Limits instructions or time of following calls and coroutines started, aborting
+	 * them with Error::Code::TIMEOUT_ERROR, like when script is stuck in endless loop
+	 */
+	void setLimit(const ExecutionLimit & limit) { fnc.setLimit(limit); }
+
+	/**
+	 * Keeps function on the stack for calls made until returned scope ends
+	 */
+	impl::CallSite bind() { return impl::CallSite(fnc); }
+
+	/**
+	 * Starts call in new lua thread, which can be suspended by yield in script
+	 */
+	template<class... Args>
+	Coroutine start(Args &&... args) { return Coroutine(fnc, std::forward<Args>(args)...); }
+
+	template<class... Args>
+	std::vector<R> operator()(Args &&... args)
+	{
+		std::vector<R> result;
+		call(result, std::forward<Args>(args)...);
+		return result;
+	}
+
+	/**
+	 * Calls function extracting its results into existing vector, reusing its storage
+	 *
+	 * \param result[out] Vector replaced with results
+	 */
 	template<class... Args>
-	std::vector<R> operator()(Args... args)
+	Error call(std::vector<R> & result, Args &&... args)
 	{
-		lua_State * state;
-		std::tie(state, lastError) = fnc(LUA_MULTRET, args...);
-		Stack stack(state);
+		result.clear();
+
+		impl::CallFrame frame(fnc.getState());
+		lastError = fnc(frame, LUA_MULTRET, std::forward<Args>(args)...);
 		if(!lastError)
-		{
-			stack.size(0);
-			return std::vector<R>();
-		}
+			return lastError;
 
-		std::vector<R> result;
-		auto it = std::inserter(result, result.end());
-		for(int i = 1; i <= stack.size(); ++i)
+		result.reserve(frame.size());
+		for(int i = 1; i <= frame.size(); ++i)
 		{
-			lastError = stack.safeGet(it, i);
+			if constexpr (utils::has_emplace_back<std::vector<R>>::value)
+			{
+				lastError = impl::Stack<R>::safeGet(frame.getState(), result.emplace_back(), frame.index(i));
+			}
+			else
+			{
+				R item;
+				lastError = impl::Stack<R>::safeGet(frame.getState(), item, frame.index(i));
+				result.push_back(std::move(item));
+			}
+
 			if(!lastError)
 			{
-				lastError = Error::stackError(
-					"function " + fnc.getName(),
-					(boost::format("extracting result %1%") % i).str(),
-					lastError.desc);
-				stack.size(0);
-				return result;
+				result.pop_back();
+				lastError = lastError.during("extracting result", i).in(fnc.getSubject());
+				return lastError;
 			}
 		}
 
-		stack.size(0);
-		return result;
+		return lastError;
 	}
 
 private:
@@ -115,33 +146,67 @@ private:
 template<class... Rs>
 class Function<MultiReturn<Rs...>>
 {
+	static_assert((impl::is_extractable<Rs>::value && ...), "Function result cannot be extracted from lua stack");
+	static_assert(!(utils::is_stack_bound_type<Rs>::value || ...),
+		"Function result would point to popped lua string, use BorrowedString or std::string");
+
 public:
 	Function(impl::Reference && ref, const std::string & name = "__UNKNOWN_FUNCTION__"):
 		lastError(Error::noError()),
 		fnc(std::move(ref), name, lastError)
 	{ }
 
-	Error error() { return lastError; }
+	Error error() const { return fnc.own(lastError); }
 	operator bool() const { return fnc; }
 
+	/**
+	 * Limits instructions or time of following calls and coroutines started, aborting
+	 * them with Error::Code::TIMEOUT_ERROR, like when script is stuck in endless loop
+	 */
+	void setLimit(const ExecutionLimit & limit) { fnc.setLimit(limit); }
+
+	/**
+	 * Keeps function on the stack for calls made until returned scope ends
+	 */
+	impl::CallSite bind() { return impl::CallSite(fnc); }
+
+	/**
+	 * Starts call in new lua thread, which can be suspended by yield in script
+	 */
 	template<class... Args>
-	std::tuple<Rs...> operator()(Args... args)
-	{
-		lua_State * state;
-		std::tie(state, lastError) = fnc(sizeof...(Rs), args...);
-		Stack stack(state);
-		if(!lastError)
-		{
-			stack.size(0);
-			return std::tuple<Rs...>();
-		}
+	Coroutine start(Args &&... args) { return Coroutine(fnc, std::forward<Args>(args)...); }
 
+	template<class... Args>
+	std::tuple<Rs...> operator()(Args &&... args)
+	{
 		std::tuple<Rs...> result;
-		lastError = impl::ExtractResults<sizeof...(Rs), std::tuple<Rs...>>::get(state, result, fnc.getName());
-		stack.size(0);
+		call(result, std::forward<Args>(args)...);
 		return result;
 	}
 
+	/**
+	 * Calls function extracting its results into existing objects
+	 *
+	 * Results being containers are refilled in place, so several columns of values
+	 * can be returned at once without allocating new storage on every call.
+	 *
+	 * \param result[out] Tuple of objects to extract results to
+	 */
+	template<class... Args>
+	Error call(std::tuple<Rs...> & result, Args &&... args)
+	{
+		impl::CallFrame frame(fnc.getState());
+		lastError = fnc(frame, sizeof...(Rs), std::forward<Args>(args)...);
+		if(!lastError)
+			return lastError;
+
+		lastError = impl::ExtractResults<sizeof...(Rs), std::tuple<Rs...>>::get(
+			frame.getState(), result, frame.getBase());
+		if(!lastError)
+			lastError = lastError.in(fnc.getSubject());
+		return lastError;
+	}
+
 private:
 	Error lastError;
 	impl::Function fnc;
@@ -24,6 +24,7 @@
 #include "impl/StackBoolean.hpp"
 #include "impl/StackPointer.hpp"
 #include "impl/StackTrivial.hpp"
+#include "impl/StackBuffer.hpp"
 
 #include <lua.hpp>
 
@@ -76,7 +77,7 @@ public:
 	template<class... Args>
 	void push(const char * frmt, Args... args)
 	{
-		lua_pushfstring(frmt, args...);
+		lua_pushfstring(state, frmt, args...);
 	}
 
 	/**
@@ -120,26 +121,13 @@ public:
 	 *
 	 * \param result[out] Variable to put extracted result
 	 * \param idx Index of element to be returned
-	 * \return True if element of lua stack is compatible with given type, false otherwise
-	 */
-	template<class T>
-	Error safeGet(T & result, int idx = -1) { return impl::Stack<T>::safeGet(state, result, idx); }
-
-	/**
-	 * Gets an element from lua stack if is compatible type
-	 *
-	 * Elements are indexed from the bottom of stack starting from 1, but can be indexed with
-	 * negative values, what means indexing from the top of stack. By default the element
-	 * from the top of stack will be returned.
-	 *
-	 * \param result[out] Insert iterator to put extracted result
-	 * \param idx Index of element to be returned
-	 * \return True if element of lua stack is compatible with given type, false otherwise
+	 * \return Error describing mismatch if element is not compatible with given type
 	 */
 	template<class T>
-	Error safeGet(std::insert_iterator<T> & result, int idx = -1)
+	Error safeGet(T & result, int idx = -1)
 	{
-		return impl::Stack<typename T::value_type>::safeGet(state, result, idx);
+		static_assert(impl::is_extractable<T>::value, "Type cannot be extracted from lua stack");
+		return impl::Stack<T>::safeGet(state, result, idx);
 	}
 
 private:
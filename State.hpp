@@ -0,0 +1,78 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "Allocator.hpp"
+
+#include <lua.hpp>
+
+#include <memory>
+#include <utility>
+
+namespace smartlua
+{
+
+/**
+ * Lua state owning the allocator it was created with
+ *
+ * The allocator outlives the state, as it's destroyed only after the state is
+ * closed.
+ *
+ * \code
+ * smartlua::State<smartlua::PoolAllocator> state;
+ * luaL_openlibs(state);
+ * state.getAllocator().setLimit(64 * 1024 * 1024);
+ * auto bytes = state.getAllocator().stats().peakBytes;
+ * \endcode
+ */
+template<class Allocator>
+class State
+{
+public:
+	/**
+	 * \param args Arguments of allocator constructor
+	 */
+	template<class... Args>
+	State(Args &&... args):
+		allocator(new Allocator(std::forward<Args>(args)...)),
+		state(lua_newstate(&Allocator::allocate, allocator.get()))
+	{ }
+
+	State(const State &) = delete;
+	State & operator =(const State &) = delete;
+
+	~State()
+	{
+		if(state)
+			lua_close(state);
+	}
+
+	/**
+	 * \return State, nullptr if it could not be created
+	 */
+	lua_State * get() const { return state; }
+	operator lua_State *() const { return state; }
+
+	Allocator & getAllocator() { return *allocator; }
+	const Allocator & getAllocator() const { return *allocator; }
+
+private:
+	std::unique_ptr<Allocator> allocator;
+	lua_State * state;
+};
+
+}
@@ -0,0 +1,366 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "Error.hpp"
+#include "Function.hpp"
+#include "State.hpp"
+#include "impl/ErrorMessage.hpp"
+#include "impl/Reference.hpp"
+
+#include <lua.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace smartlua
+{
+
+/**
+ * Set of isolated lua states prepared the same way, to be used by many threads
+ *
+ * Every state is set up and loaded with the same chunks when the pool is created.
+ * Source chunks are compiled only once, in the first state, and the others load
+ * the compiled binary. A thread checks a state out for as long as it needs it, and
+ * gets back the state it used last time if it's free, so its caches stay warm.
+ *
+ * \code
+ * smartlua::StatePool pool(std::thread::hardware_concurrency(), {{ source, "script" }});
+ * smartlua::PoolFunction<double> score(pool, "score");
+ * // or with own allocator and memory limit of every state
+ * smartlua::StatePool limited(4, {{ source, "script" }}, &luaL_openlibs,
+ * 	smartlua::StatePool::withAllocator<smartlua::PoolAllocator>(64 * 1024 * 1024));
+ * // in any thread
+ * auto lease = pool.checkout();
+ * double result = score[lease](record);
+ * \endcode
+ */
+class StatePool
+{
+public:
+	/**
+	 * Lua source or binary chunk
+	 */
+	struct Chunk
+	{
+		std::string code;
+		std::string name;
+	};
+
+	/**
+	 * Creates state owned by returned pointer, nullptr if it could not be created
+	 */
+	typedef std::function<std::shared_ptr<lua_State>()> Factory;
+
+	/**
+	 * Factory of states made by luaL_newstate
+	 */
+	static std::shared_ptr<lua_State> newState()
+	{
+		return std::shared_ptr<lua_State>(luaL_newstate(), [](lua_State * state) {
+			if(state)
+				lua_close(state);
+		});
+	}
+
+	/**
+	 * Factory of states owning allocator of given type, like State<Allocator>
+	 *
+	 * \param limit Memory limit of every state, 0 for no limit
+	 * \param args Arguments of allocator constructor
+	 */
+	template<class Allocator, class... Args>
+	static Factory withAllocator(std::size_t limit = 0, Args... args)
+	{
+		return [=] {
+			auto owner = std::make_shared<State<Allocator>>(args...);
+			owner->getAllocator().setLimit(limit);
+			return std::shared_ptr<lua_State>(owner, owner->get());
+		};
+	}
+
+	/**
+	 * Exclusive use of pooled state, returned to the pool when destroyed
+	 */
+	class Lease
+	{
+	public:
+		Lease(const Lease &) = delete;
+		Lease & operator =(const Lease &) = delete;
+
+		Lease(Lease && other):
+			pool(other.pool),
+			slot(other.slot)
+		{
+			other.pool = nullptr;
+		}
+
+		~Lease()
+		{
+			if(pool)
+				pool->release(slot);
+		}
+
+		/**
+		 * \return Leased state, nullptr for lease of pool which failed to be created
+		 */
+		lua_State * get() const { return pool ? pool->slots[slot].state.get() : nullptr; }
+		operator lua_State *() const { return get(); }
+
+		/**
+		 * \return Position of leased state in pool
+		 */
+		std::size_t index() const { return slot; }
+
+		/**
+		 * Creates handle to global function of leased state
+		 */
+		template<class R>
+		Function<R> function(const std::string & name) const
+		{
+			return Function<R>(impl::Reference::createFromGlobal(get(), name.c_str()), name);
+		}
+
+	private:
+		friend class StatePool;
+
+		Lease(StatePool * pool_, std::size_t slot_):
+			pool(pool_),
+			slot(slot_)
+		{ }
+
+		StatePool * pool;
+		std::size_t slot;
+	};
+
+	/**
+	 * Creates states and loads chunks into each of them
+	 *
+	 * If any chunk fails, all states are closed, so failed pool has no states.
+	 *
+	 * \param size Number of states
+	 * \param chunks Chunks executed in every state, in order
+	 * \param setup Called for every state before chunks are executed, by default opens
+	 * standard libraries
+	 * \param create Creates every state, by default with luaL_newstate
+	 */
+	StatePool(std::size_t size, std::vector<Chunk> chunks,
+		std::function<void(lua_State *)> setup = &luaL_openlibs, Factory create = &newState):
+		lastError(Error::noError()),
+		slots(size)
+	{
+		for(std::size_t i = 0; i < size && lastError; ++i)
+		{
+			auto & slot = slots[i];
+			slot.state = create();
+			if(!slot.state)
+			{
+				lastError = Error::memoryError().in("state pool");
+				break;
+			}
+			if(setup)
+				setup(slot.state.get());
+
+			for(auto & chunk: chunks)
+			{
+				if(!load(slot.state.get(), chunk, i == 0))
+					break;
+			}
+		}
+
+		if(!lastError)
+			close();
+	}
+
+	StatePool(const StatePool &) = delete;
+	StatePool & operator =(const StatePool &) = delete;
+
+	/**
+	 * All leases and handles to pooled states have to be destroyed before the pool
+	 */
+	~StatePool()
+	{
+		close();
+	}
+
+	/**
+	 * \return Error of pool creation
+	 */
+	Error error() const { return lastError; }
+	operator bool() const { return lastError; }
+
+	std::size_t size() const { return slots.size(); }
+
+	/**
+	 * Takes free state out of pool, waiting until any is returned if all are in use
+	 *
+	 * \return Lease of state, empty lease if pool has no states
+	 */
+	Lease checkout()
+	{
+		if(slots.empty())
+			return Lease(nullptr, 0);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		auto self = std::this_thread::get_id();
+		std::size_t found;
+		released.wait(lock, [&] { return pick(self, found); });
+
+		slots[found].busy = true;
+		slots[found].owner = self;
+		return Lease(this, found);
+	}
+
+private:
+	struct Slot
+	{
+		std::shared_ptr<lua_State> state;
+		std::thread::id owner;
+		bool busy = false;
+	};
+
+	/**
+	 * Finds free state, preferring one used last by given thread
+	 */
+	bool pick(std::thread::id self, std::size_t & found) const
+	{
+		bool any = false;
+		for(std::size_t i = 0; i < slots.size(); ++i)
+		{
+			if(slots[i].busy)
+				continue;
+			if(slots[i].owner == self)
+			{
+				found = i;
+				return true;
+			}
+			if(!any)
+			{
+				found = i;
+				any = true;
+			}
+		}
+		return any;
+	}
+
+	void close()
+	{
+		slots.clear();
+	}
+
+	void release(std::size_t slot)
+	{
+		lua_settop(slots[slot].state.get(), 0);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slots[slot].busy = false;
+		}
+		released.notify_one();
+	}
+
+	/**
+	 * Runs chunk in state, replacing its source with compiled binary if requested
+	 */
+	bool load(lua_State * state, Chunk & chunk, bool compile)
+	{
+		if(luaL_loadbufferx(state, chunk.code.data(), chunk.code.size(), chunk.name.c_str(), nullptr) != LUA_OK)
+			return fail(state);
+
+		if(compile && chunk.code.compare(0, 1, LUA_SIGNATURE, 1) != 0)
+		{
+			std::string binary;
+			if(lua_dump(state, &write, &binary, 0) == 0)
+				chunk.code = std::move(binary);
+		}
+
+		if(lua_pcall(state, 0, 0, 0) != LUA_OK)
+			return fail(state);
+
+		return true;
+	}
+
+	bool fail(lua_State * state)
+	{
+		lastError = Error::runtimeError(message.pin(state, -1)).in("state pool");
+		lua_pop(state, 1);
+		return false;
+	}
+
+	static int write(lua_State *, const void * data, std::size_t size, void * binary)
+	{
+		static_cast<std::string *>(binary)->append(static_cast<const char *>(data), size);
+		return 0;
+	}
+
+	Error lastError;
+	impl::ErrorMessage message;
+	std::vector<Slot> slots;
+	std::mutex mutex;
+	std::condition_variable released;
+};
+
+/**
+ * Handle to global function resolved separately in every state of pool
+ *
+ * Function is looked up in a state on first use through lease of that state, and
+ * the handle is kept for further uses, even if the function was not found. Threads
+ * holding leases of different states may use the handle at once. Has to be destroyed
+ * before the pool.
+ */
+template<class R>
+class PoolFunction
+{
+public:
+	PoolFunction(const StatePool & pool, const std::string & name_):
+		name(name_)
+	{
+		handles.reserve(pool.size());
+		for(std::size_t i = 0; i < pool.size(); ++i)
+			handles.emplace_back(impl::Reference(nullptr), name);
+		resolved.resize(pool.size(), 0);
+	}
+
+	/**
+	 * \param lease Non-empty lease of state from the pool
+	 * \return Function in leased state
+	 */
+	Function<R> & operator[](const StatePool::Lease & lease)
+	{
+		auto & handle = handles[lease.index()];
+		if(!resolved[lease.index()])
+		{
+			handle = lease.function<R>(name);
+			resolved[lease.index()] = true;
+		}
+		return handle;
+	}
+
+private:
+	std::string name;
+	std::vector<Function<R>> handles;
+	// not vector<bool>, whose elements share bytes written by threads of other states
+	std::vector<char> resolved;
+};
+
+}
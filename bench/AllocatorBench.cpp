@@ -0,0 +1,117 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Bench.hpp"
+
+#include "Function.hpp"
+#include "State.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace smartlua;
+using namespace smartlua::bench;
+
+namespace
+{
+
+const char * script = R"(
+	function churn(n)
+		local items = {}
+		for i = 1, n do
+			items[i] = { id = i, name = 'item' .. i, tags = { i, i + 1 } }
+		end
+		return #items
+	end
+)";
+
+/**
+ * Runs script in state, aborting the benchmark if it fails
+ */
+void load(lua_State * state)
+{
+	if(luaL_dostring(state, script) != LUA_OK)
+	{
+		std::fprintf(stderr, "lua error: %s\n", lua_tostring(state, -1));
+		std::exit(1);
+	}
+}
+
+/**
+ * Measures calls creating many small tables in long-lived state
+ */
+template<class S>
+void churn(Runner & runner, const std::string & name, S & state)
+{
+	luaL_openlibs(state);
+	load(state);
+	Function<int> function(impl::Reference::createFromGlobal(state, "churn"), "churn");
+	runner.measure("churn 100 tables " + name, state, [&] {
+		keep(function(100));
+	});
+}
+
+/**
+ * Measures state created, used for one call and closed
+ */
+template<class S>
+void shortLived(Runner & runner, bench::State & host, const std::string & name)
+{
+	runner.measure("short-lived state " + name, host, [&] {
+		S state;
+		load(state);
+		lua_getglobal(state, "churn");
+		lua_pushinteger(state, 100);
+		lua_pcall(state, 1, 1, 0);
+		keep(lua_tointeger(state, -1));
+	});
+}
+
+/**
+ * State made by luaL_newstate, closed when destroyed
+ */
+struct DefaultState
+{
+	DefaultState(): state(luaL_newstate()) { }
+	DefaultState(const DefaultState &) = delete;
+	DefaultState & operator =(const DefaultState &) = delete;
+	~DefaultState() { lua_close(state); }
+
+	operator lua_State *() const { return state; }
+
+	lua_State * state;
+};
+
+}
+
+SMARTLUA_BENCH(allocator)
+{
+	{
+		DefaultState state;
+		churn(runner, "luaL_newstate", state);
+	}
+	{
+		smartlua::State<PoolAllocator> state;
+		churn(runner, "PoolAllocator", state);
+	}
+
+	bench::State host;
+	shortLived<DefaultState>(runner, host, "luaL_newstate");
+	shortLived<smartlua::State<PoolAllocator>>(runner, host, "PoolAllocator");
+	shortLived<smartlua::State<ArenaAllocator>>(runner, host, "ArenaAllocator");
+}
@@ -0,0 +1,58 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Bench.hpp"
+
+#include "Function.hpp"
+
+#include <iterator>
+#include <tuple>
+#include <vector>
+
+using namespace smartlua;
+using namespace smartlua::bench;
+
+SMARTLUA_BENCH(batch)
+{
+	bench::State state;
+	state.run("function add(a, b) return a + b end");
+
+	Function<int> add(impl::Reference::createFromGlobal(state, "add"), "add");
+	Function<void> none(impl::Reference::createFromGlobal(state, "add"), "add");
+
+	std::vector<std::tuple<int, int>> pairs(1000, std::make_tuple(1, 2));
+	std::vector<int> results;
+	results.reserve(pairs.size());
+
+	runner.measure("operator() loop 1000 calls", state, [&] {
+		results.clear();
+		for(auto & item: pairs)
+			results.push_back(add(std::get<0>(item), std::get<1>(item)));
+	});
+	runner.measure("map 1000 calls", state, [&] {
+		results.clear();
+		keep(add.map(pairs, std::back_inserter(results)));
+	});
+
+	runner.measure("Function<void> loop 1000 calls", state, [&] {
+		for(auto & item: pairs)
+			none(std::get<0>(item), std::get<1>(item));
+	});
+	runner.measure("Function<void> forEach 1000 calls", state, [&] {
+		keep(none.forEach(pairs));
+	});
+}
@@ -0,0 +1,261 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#pragma once
+
+#include "../State.hpp"
+
+#include <lua.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace smartlua { namespace bench
+{
+
+/**
+ * Number and total size of allocations made so far
+ */
+struct Counters
+{
+	std::atomic<std::size_t> allocations{0};
+	std::atomic<std::size_t> bytes{0};
+
+	void count(std::size_t size)
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		bytes.fetch_add(size, std::memory_order_relaxed);
+	}
+};
+
+/**
+ * Allocations of C++ heap, counted by operator new replaced in main.cpp
+ */
+Counters & heap();
+
+/**
+ * \return Bytes in use by lua, including garbage not collected yet
+ */
+inline std::size_t gcBytes(lua_State * state)
+{
+	return static_cast<std::size_t>(lua_gc(state, LUA_GCCOUNT, 0)) * 1024 +
+		static_cast<std::size_t>(lua_gc(state, LUA_GCCOUNTB, 0));
+}
+
+/**
+ * Lua state with standard libraries open, counting allocations lua makes
+ */
+class State: public smartlua::State<MallocAllocator>
+{
+public:
+	State()
+	{
+		luaL_openlibs(*this);
+	}
+
+	/**
+	 * Runs lua source, aborting the benchmark if it fails
+	 */
+	void run(const char * code)
+	{
+		if(luaL_dostring(*this, code) != LUA_OK)
+		{
+			std::fprintf(stderr, "lua error: %s\n", lua_tostring(*this, -1));
+			std::exit(1);
+		}
+		lua_settop(*this, 0);
+	}
+};
+
+/**
+ * Keeps value from being optimized out
+ */
+template<class T>
+inline void keep(T && value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "g"(&value) : "memory");
+#else
+	static volatile const void * sink;
+	sink = &value;
+#endif
+}
+
+/**
+ * Measures operations and prints one row per measurement
+ *
+ * Every operation is repeated until it runs for the requested time, after short
+ * warm-up. Reported are nanoseconds, C++ heap allocations and lua allocations per
+ * operation, and bytes lua allocated per operation, measured over a sample of
+ * operations made with the garbage collector stopped. Lua allocations are counted
+ * only for states with allocator keeping AllocatorStats.
+ */
+class Runner
+{
+public:
+	static constexpr std::size_t GC_SAMPLE = 64;
+
+	/**
+	 * \param filter_ Only suites or measurements with names containing it are run
+	 * \param seconds_ Time of every measurement
+	 */
+	Runner(std::string filter_, double seconds_):
+		filter(std::move(filter_)),
+		seconds(seconds_)
+	{
+		std::printf("%-52s %12s %10s %10s %12s\n", "benchmark", "ns/op", "allocs/op", "lua/op", "lua B/op");
+	}
+
+	bool enabled(const std::string & name) const
+	{
+		return whole || name.find(filter) != std::string::npos;
+	}
+
+	double getSeconds() const { return seconds; }
+
+	/**
+	 * Starts suite, enabling all of its measurements if its title matches the filter
+	 */
+	void section(const std::string & title)
+	{
+		whole = filter.empty() || title.find(filter) != std::string::npos;
+		std::printf("\n[%s]\n", title.c_str());
+	}
+
+	/**
+	 * Measures operation made on given state
+	 *
+	 * State can be anything converting to lua_State *, like smartlua::State with its
+	 * own allocator. Lua stack is reset to its size from before the measurement after
+	 * every batch, operations leaving values on the stack have to pop them themselves.
+	 */
+	template<class F>
+	void measure(const std::string & name, lua_State * state, F && op)
+	{
+		measure(name, state, nullptr, op);
+	}
+
+	template<class A, class F>
+	void measure(const std::string & name, smartlua::State<A> & state, F && op)
+	{
+		measure(name, state, &state.getAllocator().stats(), op);
+	}
+
+	/**
+	 * Prints measurement made by caller, like throughput of many threads
+	 *
+	 * \param luaAllocations Lua allocations per operation, NAN if not counted
+	 */
+	void row(const std::string & name, double ns, double allocations, double luaAllocations, double luaBytes)
+	{
+		if(std::isnan(luaAllocations))
+			std::printf("%-52s %12.1f %10.2f %10s %12.1f\n", name.c_str(), ns, allocations, "-", luaBytes);
+		else
+			std::printf("%-52s %12.1f %10.2f %10.2f %12.1f\n", name.c_str(), ns, allocations, luaAllocations, luaBytes);
+		std::fflush(stdout);
+	}
+
+private:
+	template<class F>
+	void measure(const std::string & name, lua_State * state, const AllocatorStats * stats, F & op)
+	{
+		if(!enabled(name))
+			return;
+
+		int top = lua_gettop(state);
+		for(int i = 0; i < 100; ++i)
+			op();
+		lua_settop(state, top);
+
+		std::size_t count = 1;
+		double elapsed = 0;
+		while((elapsed = run(count, op)) < seconds / 10 && count < (std::size_t(1) << 40))
+			count *= 2;
+		lua_settop(state, top);
+		count = std::max<std::size_t>(1, static_cast<std::size_t>(count * (seconds / elapsed)));
+
+		std::size_t heapAllocations = heap().allocations.load();
+		std::size_t luaAllocations = stats ? stats->allocations : 0;
+		elapsed = run(count, op);
+		lua_settop(state, top);
+		double allocations = double(heap().allocations.load() - heapAllocations) / count;
+		double luaPerOp = stats ? double(stats->allocations - luaAllocations) / count : NAN;
+
+		std::size_t sample = std::min(count, GC_SAMPLE);
+		lua_gc(state, LUA_GCCOLLECT, 0);
+		lua_gc(state, LUA_GCSTOP, 0);
+		std::size_t bytes = gcBytes(state);
+		run(sample, op);
+		double luaBytes = double(gcBytes(state) - bytes) / sample;
+		lua_gc(state, LUA_GCRESTART, 0);
+		lua_settop(state, top);
+
+		row(name, elapsed * 1e9 / count, allocations, luaPerOp, luaBytes);
+	}
+
+	template<class F>
+	static double run(std::size_t count, F & op)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for(std::size_t i = 0; i < count; ++i)
+			op();
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::string filter;
+	double seconds;
+	bool whole = true;
+};
+
+/**
+ * Group of measurements, registered by SMARTLUA_BENCH
+ */
+struct Suite
+{
+	typedef void (*Body)(Runner &);
+
+	Suite(const char * name_, Body body_):
+		name(name_),
+		body(body_)
+	{
+		all().push_back(this);
+	}
+
+	static std::vector<Suite *> & all()
+	{
+		static std::vector<Suite *> suites;
+		return suites;
+	}
+
+	const char * name;
+	Body body;
+};
+
+} }
+
+#define SMARTLUA_BENCH(name) \
+	static void name(smartlua::bench::Runner &); \
+	static smartlua::bench::Suite name##Suite(#name, &name); \
+	static void name(smartlua::bench::Runner & runner)
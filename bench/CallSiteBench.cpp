@@ -0,0 +1,64 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Bench.hpp"
+
+#include "Function.hpp"
+
+using namespace smartlua;
+using namespace smartlua::bench;
+
+SMARTLUA_BENCH(callsite)
+{
+	bench::State state;
+	state.run("function add(a, b) return a + b end");
+
+	Function<int> add(impl::Reference::createFromGlobal(state, "add"), "add");
+	Function<void> none(impl::Reference::createFromGlobal(state, "add"), "add");
+
+	runner.measure("registry Function<int>", state, [&] {
+		keep(add(1, 2));
+	});
+	runner.measure("registry Function<void>", state, [&] {
+		none(1, 2);
+	});
+
+	{
+		auto site = add.bind();
+		runner.measure("bound Function<int>", state, [&] {
+			keep(add(1, 2));
+		});
+	}
+	{
+		auto site = none.bind();
+		runner.measure("bound Function<void>", state, [&] {
+			none(1, 2);
+		});
+	}
+
+	lua_getglobal(state, "add");
+	int slot = lua_gettop(state);
+	runner.measure("raw lua_pushvalue and lua_pcall", state, [&] {
+		lua_pushvalue(state, slot);
+		lua_pushinteger(state, 1);
+		lua_pushinteger(state, 2);
+		lua_pcall(state, 2, 1, 0);
+		keep(lua_tointeger(state, -1));
+		lua_pop(state, 1);
+	});
+	lua_pop(state, 1);
+}
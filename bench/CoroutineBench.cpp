@@ -0,0 +1,88 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Bench.hpp"
+
+#include "Function.hpp"
+#include "Coroutine.hpp"
+
+#include <cstdio>
+
+using namespace smartlua;
+using namespace smartlua::bench;
+
+namespace
+{
+
+const char * script = R"(
+	function handle(request) return request * 2 end
+	function wait(request) local reply = coroutine.yield(request) return reply end
+)";
+
+/**
+ * Runs call in new thread, left for the collector, as done without the pool
+ */
+int startThread(lua_State * state, const char * name, lua_Integer request)
+{
+	lua_State * thread = lua_newthread(state);
+	lua_getglobal(thread, name);
+	lua_pushinteger(thread, request);
+	int count = 0;
+	int status = lua_resume(thread, state, 1, &count);
+	keep(lua_tointeger(thread, -1));
+	lua_pop(state, 1);
+	return status;
+}
+
+}
+
+SMARTLUA_BENCH(coroutine)
+{
+	bench::State state;
+	state.run(script);
+
+	runner.measure("lua_newthread per call", state, [&] {
+		keep(startThread(state, "handle", 1));
+	});
+	runner.measure("lua_newthread per call with resume", state, [&] {
+		lua_State * thread = lua_newthread(state);
+		lua_getglobal(thread, "wait");
+		lua_pushinteger(thread, 1);
+		int count = 0;
+		lua_resume(thread, state, 1, &count);
+		lua_pop(thread, count);
+		lua_pushinteger(thread, 2);
+		keep(lua_resume(thread, state, 1, &count));
+		lua_pop(state, 1);
+	});
+
+	Function<void> handle(impl::Reference::createFromGlobal(state, "handle"), "handle");
+	runner.measure("pooled start()", state, [&] {
+		auto call = handle.start(1);
+		int result = 0;
+		keep(call.get(result));
+	});
+
+	Function<void> wait(impl::Reference::createFromGlobal(state, "wait"), "wait");
+	runner.measure("pooled start() with resume", state, [&] {
+		auto call = wait.start(1);
+		keep(call.resume(2));
+	});
+
+	auto pool = impl::CoroutinePool::of(state);
+	std::printf("pool threads created %zu, idle %zu\n", pool->highWater(), pool->size());
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Bench.hpp"
+
+#include "Function.hpp"
+
+#include <string>
+
+using namespace smartlua;
+using namespace smartlua::bench;
+
+namespace
+{
+
+const char * script = R"(
+	function add(a, b) return a + b end
+	function none(a) end
+	function fail(a) error('failed') end
+	function text(a) return 'text' end
+)";
+
+template<class R>
+Function<R> global(bench::State & state, const char * name)
+{
+	lua_getglobal(state, name);
+	return Function<R>(impl::Reference::createFromStack(state), name);
+}
+
+}
+
+SMARTLUA_BENCH(error)
+{
+	bench::State state;
+	state.run(script);
+
+	auto add = global<int>(state, "add");
+	runner.measure("success operator()", state, [&] {
+		keep(add(1, 2));
+	});
+	runner.measure("success operator() and error()", state, [&] {
+		keep(add(1, 2));
+		keep(add.error());
+	});
+
+	int sum = 0;
+	runner.measure("success call(R &)", state, [&] {
+		keep(add.call(sum, 1, 2));
+	});
+
+	auto none = global<void>(state, "none");
+	runner.measure("success Function<void>", state, [&] {
+		none(1);
+		keep(none.error());
+	});
+
+	auto fail = global<int>(state, "fail");
+	runner.measure("runtime error", state, [&] {
+		keep(fail(1));
+		keep(fail.error());
+	});
+	runner.measure("runtime error and message()", state, [&] {
+		keep(fail(1));
+		keep(fail.error().message());
+	});
+
+	auto text = global<int>(state, "text");
+	runner.measure("stack error", state, [&] {
+		keep(text(1));
+		keep(text.error());
+	});
+	runner.measure("stack error and message()", state, [&] {
+		keep(text(1));
+		keep(text.error().message());
+	});
+}
@@ -0,0 +1,83 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Bench.hpp"
+
+#include "Function.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace smartlua;
+using namespace smartlua::bench;
+
+namespace
+{
+
+/**
+ * Call chain taking arguments by value at every level, as calls did before forwarding
+ */
+inline void pushCopies(lua_State *)
+{
+}
+
+template<class Head, class... Tail>
+void pushCopies(lua_State * state, Head head, Tail... tail)
+{
+	impl::Stack<Head>::push(state, head);
+	pushCopies(state, tail...);
+}
+
+template<class... Args>
+int callCopies(lua_State * state, Args... args)
+{
+	lua_getglobal(state, "count");
+	pushCopies(state, args...);
+	lua_pcall(state, sizeof...(Args), 1, 0);
+	int result = static_cast<int>(lua_tointeger(state, -1));
+	lua_pop(state, 1);
+	return result;
+}
+
+std::vector<std::string> words(std::size_t size)
+{
+	return std::vector<std::string>(size, std::string(32, 'x'));
+}
+
+}
+
+SMARTLUA_BENCH(forwarding)
+{
+	bench::State state;
+	state.run("function count(a, b, c) return #a + #b + #c end");
+
+	lua_getglobal(state, "count");
+	Function<int> count(impl::Reference::createFromStack(state), "count");
+
+	for(std::size_t size : {4, 64})
+	{
+		auto value = words(size);
+		std::string suffix = " vector<string> " + std::to_string(size) + " x3";
+
+		runner.measure("by value" + suffix, state, [&] {
+			keep(callCopies(state, value, value, value));
+		});
+		runner.measure("forwarded" + suffix, state, [&] {
+			keep(count(value, value, value));
+		});
+	}
+}
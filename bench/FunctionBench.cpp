@@ -0,0 +1,149 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Bench.hpp"
+
+#include "Function.hpp"
+#include "MultireturnFunction.hpp"
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace smartlua;
+using namespace smartlua::bench;
+
+namespace
+{
+
+const char * script = R"(
+	function none() end
+	function one(a) return a end
+	function length(a, b, c, d, e, f, g, h) return #a end
+	function many(a) return a, a, a, a end
+	function mixed(a) return a, 0.5, 'text' end
+)";
+
+template<class R>
+Function<R> global(bench::State & state, const char * name)
+{
+	lua_getglobal(state, name);
+	return Function<R>(impl::Reference::createFromStack(state), name);
+}
+
+/**
+ * Measures call returning payload it was given
+ */
+template<class T>
+void echo(Runner & runner, bench::State & state, const std::string & name, const T & payload)
+{
+	auto one = global<T>(state, "one");
+	runner.measure(name, state, [&] {
+		keep(one(payload));
+	});
+}
+
+/**
+ * Measures calls with payload passed as one, three and eight arguments
+ */
+template<class T>
+void calls(Runner & runner, bench::State & state, const std::string & name, const T & payload)
+{
+	auto length = global<int>(state, "length");
+
+	runner.measure(name + " 1 arg", state, [&] {
+		keep(length(payload));
+	});
+	runner.measure(name + " 3 args", state, [&] {
+		keep(length(payload, payload, payload));
+	});
+	runner.measure(name + " 8 args", state, [&] {
+		keep(length(payload, payload, payload, payload, payload, payload, payload, payload));
+	});
+}
+
+}
+
+SMARTLUA_BENCH(function)
+{
+	bench::State state;
+	state.run(script);
+
+	runner.measure("raw lua_pcall 0 args", state, [&] {
+		lua_getglobal(state, "none");
+		lua_pcall(state, 0, 0, 0);
+	});
+	runner.measure("raw lua_pcall int 1 arg", state, [&] {
+		lua_getglobal(state, "one");
+		lua_pushinteger(state, 1);
+		lua_pcall(state, 1, 1, 0);
+		keep(lua_tointeger(state, -1));
+		lua_pop(state, 1);
+	});
+
+	auto none = global<void>(state, "none");
+	runner.measure("Function<void> 0 args", state, [&] {
+		none();
+	});
+
+	auto oneVoid = global<void>(state, "one");
+	runner.measure("Function<void> int 1 arg", state, [&] {
+		oneVoid(1);
+	});
+
+	auto oneInt = global<int>(state, "one");
+	runner.measure("Function<int> int 1 arg", state, [&] {
+		keep(oneInt(1));
+	});
+
+	auto oneDouble = global<double>(state, "one");
+	runner.measure("Function<double> double 1 arg", state, [&] {
+		keep(oneDouble(0.5));
+	});
+
+	calls(runner, state, "Function<int> string 16", std::string(16, 'x'));
+	calls(runner, state, "Function<int> string 1024", std::string(1024, 'x'));
+	calls(runner, state, "Function<int> vector<double> 16", std::vector<double>(16, 0.5));
+	calls(runner, state, "Function<int> vector<double> 1024", std::vector<double>(1024, 0.5));
+
+	echo(runner, state, "Function<string> string 16 result", std::string(16, 'x'));
+	echo(runner, state, "Function<string> string 1024 result", std::string(1024, 'x'));
+	echo(runner, state, "Function<vector<double>> vector 16 result", std::vector<double>(16, 0.5));
+	echo(runner, state, "Function<vector<double>> vector 1024 result", std::vector<double>(1024, 0.5));
+
+	auto oneVector = global<std::vector<double>>(state, "one");
+	std::vector<double> input(1024, 0.5);
+	std::vector<double> output;
+	runner.measure("Function<vector<double>> vector 1024 call", state, [&] {
+		keep(oneVector.call(output, input));
+	});
+
+	auto many = global<MultiReturn<int>>(state, "many");
+	runner.measure("Function<MultiReturn<int>> 4 results", state, [&] {
+		keep(many(1));
+	});
+
+	std::vector<int> column;
+	runner.measure("Function<MultiReturn<int>> call 4 results", state, [&] {
+		keep(many.call(column, 1));
+	});
+
+	auto mixed = global<MultiReturn<int, double, std::string>>(state, "mixed");
+	runner.measure("Function<MultiReturn<int, double, string>>", state, [&] {
+		keep(mixed(1));
+	});
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Bench.hpp"
+
+#include "Stack.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace smartlua;
+using namespace smartlua::bench;
+
+namespace
+{
+
+/**
+ * Sequence push as done before, with size as hash part hint and lua_settable per element
+ */
+template<class T>
+void settableSequence(lua_State * state, const T & val)
+{
+	lua_createtable(state, 0, static_cast<int>(val.size()));
+	lua_Integer i = 1;
+	for(auto & item: val)
+	{
+		lua_pushinteger(state, i++);
+		impl::Stack<typename T::value_type>::push(state, item);
+		lua_settable(state, -3);
+	}
+}
+
+/**
+ * Key-value push with lua_settable into table growing from empty
+ */
+template<class T>
+void settableMapping(lua_State * state, const T & val)
+{
+	lua_newtable(state);
+	for(auto & item: val)
+	{
+		impl::Stack<typename T::key_type>::push(state, item.first);
+		impl::Stack<typename T::mapped_type>::push(state, item.second);
+		lua_settable(state, -3);
+	}
+}
+
+template<class T, class Baseline>
+void push(Runner & runner, bench::State & state, const std::string & name, const T & value, Baseline baseline)
+{
+	std::string suffix = " " + name + " " + std::to_string(value.size());
+	runner.measure("lua_settable" + suffix, state, [&] {
+		baseline(state, value);
+		lua_pop(state, 1);
+	});
+	runner.measure("Stack push" + suffix, state, [&] {
+		impl::Stack<T>::push(state, value);
+		lua_pop(state, 1);
+	});
+}
+
+}
+
+SMARTLUA_BENCH(iterable)
+{
+	bench::State state;
+
+	for(int size : {10, 1000, 100000})
+	{
+		std::vector<double> vector(size);
+		std::set<int> set;
+		std::map<int, double> map;
+		std::unordered_map<std::string, int> names;
+		for(int i = 0; i < size; ++i)
+		{
+			vector[i] = i * 0.5;
+			set.insert(i);
+			map[i] = i * 0.5;
+			names["key" + std::to_string(i)] = i;
+		}
+
+		push(runner, state, "vector<double>", vector, &settableSequence<std::vector<double>>);
+		push(runner, state, "set<int>", set, &settableSequence<std::set<int>>);
+		push(runner, state, "map<int, double>", map, &settableMapping<std::map<int, double>>);
+		push(runner, state, "unordered_map<string, int>", names,
+			&settableMapping<std::unordered_map<std::string, int>>);
+	}
+}
@@ -0,0 +1,69 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Bench.hpp"
+
+#include "Function.hpp"
+
+#include <chrono>
+#include <string>
+
+using namespace smartlua;
+using namespace smartlua::bench;
+
+namespace
+{
+
+/**
+ * Measures calls of function looping given number of times, with limit set
+ */
+void spin(Runner & runner, bench::State & state, const std::string & name, int loops, const ExecutionLimit & limit)
+{
+	Function<int> function(impl::Reference::createFromGlobal(state, "spin"), "spin");
+	function.setLimit(limit);
+	runner.measure(name + " loop " + std::to_string(loops), state, [&] {
+		keep(function(loops));
+	});
+}
+
+}
+
+SMARTLUA_BENCH(limit)
+{
+	bench::State state;
+	state.run(R"(
+		function spin(n)
+			local sum = 0
+			for i = 1, n do
+				sum = sum + i
+			end
+			return sum
+		end
+	)");
+
+	ExecutionLimit instructions;
+	instructions.instructions = std::size_t(1) << 40;
+	ExecutionLimit time;
+	time.time = std::chrono::hours(1);
+
+	for(int loops: {1, 1000})
+	{
+		spin(runner, state, "unlimited", loops, ExecutionLimit());
+		spin(runner, state, "instruction limit", loops, instructions);
+		spin(runner, state, "time limit", loops, time);
+	}
+}
@@ -0,0 +1,143 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Bench.hpp"
+
+#include "StatePool.hpp"
+#include "Executor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace smartlua;
+using namespace smartlua::bench;
+
+namespace
+{
+
+const char * script = R"(
+	function score(n)
+		local sum = 0
+		for i = 1, n do sum = sum + i * 0.5 end
+		return sum
+	end
+)";
+
+/**
+ * Measures calls made by given number of threads at once, each owning one state
+ *
+ * Reported time is wall time divided by calls made by all threads, so perfect
+ * scaling halves it with every doubling of threads.
+ */
+void throughput(Runner & runner, std::size_t threads, bool leasePerCall)
+{
+	std::string name = "pool " + std::to_string(threads) + (threads == 1 ? " thread" : " threads") +
+		(leasePerCall ? " checkout per call" : "");
+	if(!runner.enabled(name))
+		return;
+
+	StatePool pool(threads, {{ script, "score" }});
+	PoolFunction<double> score(pool, "score");
+
+	std::atomic<bool> stop{false};
+	std::atomic<std::size_t> calls{0};
+	std::vector<std::thread> workers;
+
+	auto work = [&] {
+		std::size_t count = 0;
+		if(leasePerCall)
+		{
+			for(; !stop.load(std::memory_order_relaxed); ++count)
+			{
+				auto lease = pool.checkout();
+				keep(score[lease](100));
+			}
+		}
+		else
+		{
+			auto lease = pool.checkout();
+			for(; !stop.load(std::memory_order_relaxed); ++count)
+				keep(score[lease](100));
+		}
+		calls += count;
+	};
+
+	std::size_t allocations = heap().allocations.load();
+	auto start = std::chrono::steady_clock::now();
+	for(std::size_t i = 0; i < threads; ++i)
+		workers.emplace_back(work);
+	std::this_thread::sleep_for(std::chrono::duration<double>(runner.getSeconds()));
+	stop = true;
+	for(auto & worker: workers)
+		worker.join();
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::size_t total = std::max<std::size_t>(1, calls.load());
+	runner.row(name, elapsed * 1e9 / total,
+		double(heap().allocations.load() - allocations) / total, NAN, 0);
+}
+
+/**
+ * Measures calls submitted to executor running on given number of workers
+ *
+ * Calls are submitted in batches of 1000 from a single thread, which then waits
+ * for all of their results.
+ */
+void executor(Runner & runner, std::size_t threads)
+{
+	std::string name = "executor " + std::to_string(threads) + (threads == 1 ? " worker" : " workers");
+	if(!runner.enabled(name))
+		return;
+
+	StatePool pool(threads, {{ script, "score" }});
+	Executor executor(pool);
+	std::vector<std::future<Result<double>>> results(1000);
+
+	std::size_t calls = 0;
+	std::size_t allocations = heap().allocations.load();
+	auto start = std::chrono::steady_clock::now();
+	double elapsed = 0;
+	while((elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()) < runner.getSeconds())
+	{
+		for(auto & result: results)
+			result = executor.submit<double>("score", 100);
+		for(auto & result: results)
+			keep(result.get());
+		calls += results.size();
+	}
+
+	runner.row(name, elapsed * 1e9 / calls,
+		double(heap().allocations.load() - allocations) / calls, NAN, 0);
+}
+
+}
+
+SMARTLUA_BENCH(pool)
+{
+	std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+	for(std::size_t threads = 1; threads <= std::max<std::size_t>(cores, 4); threads *= 2)
+	{
+		throughput(runner, threads, false);
+		throughput(runner, threads, true);
+		executor(runner, threads);
+	}
+}
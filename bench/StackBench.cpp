@@ -0,0 +1,107 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Bench.hpp"
+
+#include "Stack.hpp"
+#include "BorrowedString.hpp"
+
+#include <array>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+using namespace smartlua;
+using namespace smartlua::bench;
+
+namespace
+{
+
+struct Point
+{
+	double x;
+	double y;
+};
+
+/**
+ * Measures push, get and safeGet of single value
+ */
+template<class T>
+void stack(Runner & runner, bench::State & state, const std::string & name, const T & value)
+{
+	int top = lua_gettop(state);
+	runner.measure(name + " push", state, [&] {
+		impl::Stack<T>::push(state, value);
+		lua_settop(state, top);
+	});
+
+	impl::Stack<T>::push(state, value);
+	int idx = lua_gettop(state);
+	runner.measure(name + " get", state, [&] {
+		keep(impl::Stack<T>::get(state, idx));
+	});
+
+	T result{};
+	runner.measure(name + " safeGet", state, [&] {
+		keep(impl::Stack<T>::safeGet(state, result, idx));
+	});
+	lua_settop(state, top);
+}
+
+template<class T>
+std::vector<T> sequence(std::size_t size)
+{
+	std::vector<T> result(size);
+	for(std::size_t i = 0; i < size; ++i)
+		result[i] = static_cast<T>(i);
+	return result;
+}
+
+}
+
+SMARTLUA_BENCH(stack)
+{
+	bench::State state;
+	std::string text(1024, 'x');
+	Point point { 1, 2 };
+
+	stack(runner, state, "integral int", 42);
+	stack(runner, state, "integral long long", 42ll);
+	stack(runner, state, "floating double", 0.5);
+	stack(runner, state, "floating float", 0.5f);
+	stack(runner, state, "boolean", true);
+	stack(runner, state, "string 16", std::string(16, 'x'));
+	stack(runner, state, "string 1024", std::string(1024, 'x'));
+	stack(runner, state, "string_view 16", std::string_view("xxxxxxxxxxxxxxxx"));
+	stack(runner, state, "string_view 1024", std::string_view(text));
+	stack(runner, state, "const char * 16", static_cast<const char *>("xxxxxxxxxxxxxxxx"));
+	lua_pushstring(state, "xxxxxxxxxxxxxxxx");
+	stack(runner, state, "BorrowedString 16", impl::Stack<BorrowedString>::get(state, -1));
+	lua_pop(state, 1);
+	stack(runner, state, "pointer", &point);
+	stack(runner, state, "trivial", point);
+	stack(runner, state, "iterable vector<int> 16", sequence<int>(16));
+	stack(runner, state, "iterable vector<int> 1024", sequence<int>(1024));
+	stack(runner, state, "iterable vector<double> 1024", sequence<double>(1024));
+	stack(runner, state, "iterable map<string, int> 16", std::map<std::string, int> {
+		{"a", 1}, {"b", 2}, {"c", 3}, {"d", 4}, {"e", 5}, {"f", 6}, {"g", 7}, {"h", 8},
+		{"i", 9}, {"j", 10}, {"k", 11}, {"l", 12}, {"m", 13}, {"n", 14}, {"o", 15}, {"p", 16}});
+	stack(runner, state, "tuple<int, double, string>", std::make_tuple(1, 2.0, std::string("three")));
+	stack(runner, state, "array<double, 4>", std::array<double, 4> {{1, 2, 3, 4}});
+}
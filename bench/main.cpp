@@ -0,0 +1,92 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Bench.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+namespace smartlua { namespace bench
+{
+
+Counters & heap()
+{
+	static Counters counters;
+	return counters;
+}
+
+} }
+
+void * operator new(std::size_t size)
+{
+	smartlua::bench::heap().count(size);
+	if(void * ptr = std::malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void * operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void * ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void * ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void * ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void * ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+/**
+ * Usage: smartlua_bench [filter] [--time seconds]
+ */
+int main(int argc, char ** argv)
+{
+	std::string filter;
+	double seconds = 0.2;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(std::strcmp(argv[i], "--time") == 0 && i + 1 < argc)
+			seconds = std::atof(argv[++i]);
+		else
+			filter = argv[i];
+	}
+
+	smartlua::bench::Runner runner(filter, seconds);
+	for(auto suite: smartlua::bench::Suite::all())
+	{
+		runner.section(suite->name);
+		suite->body(runner);
+	}
+	return 0;
+}
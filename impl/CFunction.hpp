@@ -0,0 +1,100 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "../Stack.hpp"
+#include "../utils/Traits.hpp"
+#include "Class.hpp"
+#include "Invoker.hpp"
+
+#include <lua.hpp>
+
+#include <type_traits>
+#include <utility>
+
+namespace smartlua { namespace impl
+{
+
+/**
+ * Trampolines calling C++ callables from lua
+ */
+template<class R, class... Args>
+struct CFunction
+{
+	/**
+	 * Calls function known at compile time, needs no upvalues
+	 */
+	template<auto F>
+	static int callStatic(lua_State * state)
+	{
+		return Invoker<R, Args...>::call(state, 1, F);
+	}
+
+	/**
+	 * Calls stateless functor, constructed on every call
+	 */
+	template<class F>
+	static int callStateless(lua_State * state)
+	{
+		return Invoker<R, Args...>::call(state, 1, F());
+	}
+
+	/**
+	 * Calls function pointer stored in upvalue
+	 */
+	static int callPointer(lua_State * state)
+	{
+		return Invoker<R, Args...>::call(state, 1, getUpvalue<R (*)(Args...)>(state, 1));
+	}
+
+	/**
+	 * Calls functor stored as userdata in upvalue
+	 */
+	template<class F>
+	static int callFunctor(lua_State * state)
+	{
+		F & f = *static_cast<F *>(lua_touserdata(state, lua_upvalueindex(1)));
+		return Invoker<R, Args...>::call(state, 1, f);
+	}
+
+	template<class F>
+	static void push(lua_State * state, F && f)
+	{
+		typedef typename std::decay<F>::type Functor;
+
+		lua_CFunction trampoline;
+		if constexpr(std::is_empty<Functor>::value && std::is_default_constructible<Functor>::value)
+		{
+			trampoline = &callStateless<Functor>;
+			lua_pushcfunction(state, trampoline);
+		}
+		else if constexpr(std::is_convertible<Functor, R (*)(Args...)>::value)
+		{
+			pushUpvalue<R (*)(Args...)>(state, f);
+			trampoline = &callPointer;
+			lua_pushcclosure(state, trampoline, 1);
+		}
+		else
+		{
+			Stack<Functor>::emplace(state, std::forward<F>(f));
+			trampoline = &callFunctor<Functor>;
+			lua_pushcclosure(state, trampoline, 1);
+		}
+	}
+};
+
+} }
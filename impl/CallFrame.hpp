@@ -0,0 +1,98 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "../Stack.hpp"
+
+#include <lua.hpp>
+
+#include <type_traits>
+#include <utility>
+
+namespace smartlua { namespace impl
+{
+
+/**
+ * Scoped part of lua stack used by a single function call
+ *
+ * Records top of the stack once when created and restores the stack exactly to it
+ * when destroyed, so the called function, its arguments, results and error message
+ * are all removed, while anything pushed before the frame stays untouched. Frames
+ * may be freely nested.
+ */
+class CallFrame
+{
+public:
+	CallFrame() = delete;
+	CallFrame(const CallFrame &) = delete;
+	CallFrame & operator =(const CallFrame &) = delete;
+
+	CallFrame(lua_State * state_):
+		state(state_),
+		base(lua_gettop(state_))
+	{ }
+
+	~CallFrame()
+	{
+		lua_settop(state, base);
+	}
+
+	lua_State * getState() const { return state; }
+
+	/**
+	 * \return Index of the last stack element below the frame
+	 */
+	int getBase() const { return base; }
+
+	/**
+	 * \return Number of elements pushed within the frame
+	 */
+	int size() const { return lua_gettop(state) - base; }
+
+	/**
+	 * \param i Position of element in frame, starting from 1
+	 * \return Absolute stack index of element
+	 */
+	int index(int i) const { return base + i; }
+
+	/**
+	 * Pushes all values in place on top of the frame
+	 */
+	template<class... Args>
+	void push(Args &&... args)
+	{
+		(Stack<typename std::decay<Args>::type>::push(state, std::forward<Args>(args)), ...);
+	}
+
+	/**
+	 * Calls function pushed in frame below given number of arguments
+	 *
+	 * \param argc Number of arguments on top of the frame
+	 * \param retc Number of expected results or LUA_MULTRET
+	 * \return Status returned by lua_pcall
+	 */
+	int call(int argc, int retc)
+	{
+		return lua_pcall(state, argc, retc, 0);
+	}
+
+private:
+	lua_State * state;
+	int base;
+};
+
+} }
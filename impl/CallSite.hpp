@@ -0,0 +1,57 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "CallFrame.hpp"
+#include "Function.hpp"
+
+namespace smartlua { namespace impl
+{
+
+/**
+ * Scope in which lua function is kept on the stack for repeated calls
+ *
+ * On creation the function is pushed once, and every call made through the bound
+ * function object while the scope lives copies it with lua_pushvalue instead of
+ * looking it up in the registry. The slot is popped when the scope ends, so scopes
+ * have to be destroyed in reverse order of creation, like any other use of the stack.
+ */
+class CallSite
+{
+public:
+	CallSite() = delete;
+	CallSite(const CallSite &) = delete;
+	CallSite & operator =(const CallSite &) = delete;
+
+	CallSite(Function & fnc_):
+		frame(fnc_.getState()),
+		fnc(fnc_),
+		previous(fnc_.pin())
+	{ }
+
+	~CallSite()
+	{
+		fnc.unpin(previous);
+	}
+
+private:
+	CallFrame frame;
+	Function & fnc;
+	int previous;
+};
+
+} }
@@ -0,0 +1,200 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "../Stack.hpp"
+#include "Invoker.hpp"
+
+#include <lua.hpp>
+
+#include <cstring>
+#include <type_traits>
+
+namespace smartlua { namespace impl
+{
+
+/**
+ * Object of bound class on lua stack
+ */
+template<class T>
+struct Self
+{
+	/**
+	 * \return Pointer to object at stack index 1, raises lua error if there is no
+	 * object of bound class there
+	 */
+	static T * get(lua_State * state)
+	{
+		if(!Stack<T>::is(state, 1))
+			luaL_argerror(state, 1,
+				lua_pushfstring(state, "object expected, %s found", luaL_typename(state, 1)));
+
+		return static_cast<T *>(lua_touserdata(state, 1));
+	}
+};
+
+/**
+ * Pushes trivially copyable value to userdata to be used as closure upvalue
+ */
+template<class V>
+void pushUpvalue(lua_State * state, V value)
+{
+	std::memcpy(lua_newuserdata(state, sizeof(V)), &value, sizeof(V));
+}
+
+template<class V>
+V getUpvalue(lua_State * state, int i)
+{
+	V value;
+	std::memcpy(&value, lua_touserdata(state, lua_upvalueindex(i)), sizeof(V));
+	return value;
+}
+
+template<class T, class M, class R, class... Args>
+struct MethodClosure
+{
+	/**
+	 * Pushes closure calling member function
+	 *
+	 * Member function pointer is stored as closure upvalue, so the call doesn't
+	 * need any lookup beside the one done by lua itself.
+	 */
+	static void push(lua_State * state, M method)
+	{
+		pushUpvalue(state, method);
+		lua_pushcclosure(state, &call, 1);
+	}
+
+private:
+	static int call(lua_State * state)
+	{
+		T * self = Self<T>::get(state);
+		M method = getUpvalue<M>(state, 1);
+		return Invoker<R, Args...>::call(state, 2, [self, method](auto &&... args) -> decltype(auto) {
+			return (self->*method)(std::forward<decltype(args)>(args)...);
+		});
+	}
+};
+
+template<class T, class M>
+struct Method;
+
+template<class T, class C, class R, class... Args>
+struct Method<T, R (C::*)(Args...)>: MethodClosure<T, R (C::*)(Args...), R, Args...> { };
+
+template<class T, class C, class R, class... Args>
+struct Method<T, R (C::*)(Args...) const>: MethodClosure<T, R (C::*)(Args...) const, R, Args...> { };
+
+template<class T, class C, class R, class... Args>
+struct Method<T, R (C::*)(Args...) noexcept>: MethodClosure<T, R (C::*)(Args...) noexcept, R, Args...> { };
+
+template<class T, class C, class R, class... Args>
+struct Method<T, R (C::*)(Args...) const noexcept>: MethodClosure<T, R (C::*)(Args...) const noexcept, R, Args...> { };
+
+/**
+ * Accessors of data member of bound class
+ */
+template<class T, class M>
+struct Property
+{
+	typedef typename std::remove_const<M>::type Value;
+
+	static constexpr bool writable = !std::is_const<M>::value;
+
+	static void pushGetter(lua_State * state, M T::* member)
+	{
+		pushUpvalue(state, member);
+		lua_pushcclosure(state, &get, 1);
+	}
+
+	static void pushSetter(lua_State * state, M T::* member)
+	{
+		pushUpvalue(state, member);
+		lua_pushcclosure(state, &set, 1);
+	}
+
+private:
+	static int get(lua_State * state)
+	{
+		T * self = Self<T>::get(state);
+		Stack<Value>::push(state, self->*getUpvalue<M T::*>(state, 1));
+		return 1;
+	}
+
+	static int set(lua_State * state)
+	{
+		T * self = Self<T>::get(state);
+		if(!Stack<Value>::is(state, 2))
+			return luaL_argerror(state, 2,
+				lua_pushfstring(state, "unexpected %s", luaL_typename(state, 2)));
+
+		self->*getUpvalue<M T::*>(state, 1) = Stack<Value>::get(state, 2);
+		return 0;
+	}
+};
+
+/**
+ * Metamethods of bound class
+ */
+struct ClassMetamethods
+{
+	/**
+	 * __index with methods table as upvalue 1, and getters table as upvalue 2
+	 */
+	static int index(lua_State * state)
+	{
+		lua_pushvalue(state, 2);
+		if(lua_rawget(state, lua_upvalueindex(1)) != LUA_TNIL)
+			return 1;
+
+		lua_pushvalue(state, 2);
+		if(lua_rawget(state, lua_upvalueindex(2)) == LUA_TNIL)
+			return 1;
+
+		lua_pushvalue(state, 1);
+		lua_call(state, 1, 1);
+		return 1;
+	}
+
+	/**
+	 * __newindex with setters table as upvalue 1
+	 */
+	static int newindex(lua_State * state)
+	{
+		lua_pushvalue(state, 2);
+		if(lua_rawget(state, lua_upvalueindex(1)) == LUA_TNIL)
+			return luaL_error(state, "field '%s' can't be assigned", lua_tostring(state, 2));
+
+		lua_pushvalue(state, 1);
+		lua_pushvalue(state, 3);
+		lua_call(state, 2, 0);
+		return 0;
+	}
+};
+
+template<class T, class... Args>
+struct Constructor
+{
+	static int call(lua_State * state)
+	{
+		return Invoker<void, Args...>::call(state, 1, [state](auto &&... args) {
+			Stack<T>::emplace(state, std::forward<decltype(args)>(args)...);
+		}) + 1;
+	}
+};
+
+} }
@@ -0,0 +1,177 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "Stack.hpp"
+#include "Reference.hpp"
+
+#include <lua.hpp>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace smartlua { namespace impl
+{
+
+/**
+ * Lua threads of single state kept for reuse by coroutine calls
+ *
+ * Finished threads are reset and kept anchored in registry, so starting next call
+ * takes one of them instead of creating new thread with its own stack. Pool lives in
+ * userdata kept in registry, and is destroyed with the state. Pool and threads are
+ * created in protected calls, so running out of memory is reported to the caller.
+ */
+class CoroutinePool
+{
+public:
+	/**
+	 * Lua thread and reference anchoring it
+	 */
+	struct Entry
+	{
+		lua_State * thread;
+		Reference ref;
+	};
+
+	CoroutinePool(lua_State * main_):
+		main(main_),
+		created(0)
+	{ }
+
+	CoroutinePool(const CoroutinePool &) = delete;
+	CoroutinePool & operator =(const CoroutinePool &) = delete;
+
+	/**
+	 * \return Pool of state given thread belongs to, created on first use, nullptr if
+	 * there is no memory to create it
+	 */
+	static CoroutinePool * of(lua_State * state)
+	{
+		if(!lua_checkstack(state, 2))
+			return nullptr;
+
+		CoroutinePool * pool = nullptr;
+		if(lua_rawgetp(state, LUA_REGISTRYINDEX, &key) == LUA_TUSERDATA)
+		{
+			pool = static_cast<CoroutinePool *>(lua_touserdata(state, -1));
+		}
+		else
+		{
+			lua_pop(state, 1);
+			lua_pushcfunction(state, &create);
+			if(lua_pcall(state, 0, 1, 0) == LUA_OK)
+				pool = static_cast<CoroutinePool *>(lua_touserdata(state, -1));
+		}
+		lua_pop(state, 1);
+		return pool;
+	}
+
+	/**
+	 * Takes idle thread, creating new one only if there is none
+	 *
+	 * \param state Thread of the state able to make calls, used to create new thread
+	 * \param entry[out] Taken thread
+	 * \return False if there is no memory for new thread
+	 */
+	bool acquire(lua_State * state, Entry & entry)
+	{
+		if(!idle.empty())
+		{
+			entry = std::move(idle.back());
+			idle.pop_back();
+			return true;
+		}
+
+		if(!lua_checkstack(state, 2))
+			return false;
+		lua_pushcfunction(state, &spawn);
+		if(lua_pcall(state, 0, 2, 0) != LUA_OK)
+		{
+			lua_pop(state, 1);
+			return false;
+		}
+
+		++created;
+		entry.thread = lua_tothread(state, -2);
+		entry.ref = Reference(main, static_cast<int>(lua_tointeger(state, -1)));
+		lua_pop(state, 2);
+		return true;
+	}
+
+	/**
+	 * Resets thread, closing its pending to-be-closed variables, and keeps it for reuse
+	 *
+	 * Thread which returned normally has nothing to close and is only cleared, as
+	 * resetting it would also shrink its stack, to be grown again by the next call.
+	 */
+	void release(Entry && entry)
+	{
+		if(lua_status(entry.thread) == LUA_OK)
+			lua_settop(entry.thread, 0);
+		else
+#if LUA_VERSION_RELEASE_NUM >= 50406
+			lua_closethread(entry.thread, main);
+#else
+			lua_resetthread(entry.thread);
+#endif
+		idle.push_back(std::move(entry));
+	}
+
+	/**
+	 * \return Number of idle threads
+	 */
+	std::size_t size() const { return idle.size(); }
+
+	/**
+	 * \return Number of threads ever created, which is the highest number of calls
+	 * running at once
+	 */
+	std::size_t highWater() const { return created; }
+
+private:
+	static int create(lua_State * state)
+	{
+		lua_rawgeti(state, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+		lua_State * main = lua_tothread(state, -1);
+		lua_pop(state, 1);
+
+		Stack<CoroutinePool>::emplace(state, main);
+		lua_pushvalue(state, -1);
+		lua_rawsetp(state, LUA_REGISTRYINDEX, &key);
+		return 1;
+	}
+
+	/**
+	 * Creates thread anchored in registry, returns it with its reference
+	 */
+	static int spawn(lua_State * state)
+	{
+		lua_newthread(state);
+		lua_pushvalue(state, -1);
+		lua_pushinteger(state, luaL_ref(state, LUA_REGISTRYINDEX));
+		return 2;
+	}
+
+	static inline const char key = 0;
+
+	lua_State * main;
+	std::size_t created;
+	std::vector<Entry> idle;
+};
+
+} }
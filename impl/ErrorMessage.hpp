@@ -0,0 +1,67 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#pragma once
+
+#include <lua.hpp>
+
+#include <string>
+
+namespace smartlua { namespace impl
+{
+
+/**
+ * Runtime error message owned by the object which reported it
+ *
+ * Message is copied only when an error occurs, so successful calls never touch it.
+ */
+class ErrorMessage
+{
+public:
+	/**
+	 * Copies error object into the message, replacing previously kept one
+	 *
+	 * Only string error objects are copied as they are. Converting any other object
+	 * could call its __tostring metamethod outside of protected call, and error raised
+	 * there would abort the host, so only its type is described instead.
+	 *
+	 * \param idx Stack index of error object
+	 * \return Message valid until next message is pinned in this object
+	 */
+	const char * pin(lua_State * state, int idx)
+	{
+		int type = lua_type(state, idx);
+		if(type == LUA_TSTRING)
+		{
+			std::size_t length;
+			const char * error = lua_tolstring(state, idx, &length);
+			text.assign(error, length);
+		}
+		else
+		{
+			text.assign("error object is a ").append(lua_typename(state, type)).append(" value");
+		}
+		return text.c_str();
+	}
+
+	const char * get() const { return text.c_str(); }
+
+private:
+	std::string text;
+};
+
+} }
@@ -18,94 +18,270 @@
 
 #include "../Stack.hpp"
 #include "../Error.hpp"
+#include "../ExecutionLimit.hpp"
+#include "CallFrame.hpp"
+#include "ErrorMessage.hpp"
 #include "Reference.hpp"
+#include "SharedReference.hpp"
 
 #include <string>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 
 namespace smartlua { namespace impl
 {
 
+/**
+ * Number of arguments passed for single element of batch call
+ */
+template<class Item>
+struct BatchArity: std::integral_constant<int, 1> { };
+
+template<class... Args>
+struct BatchArity<std::tuple<Args...>>: std::integral_constant<int, sizeof...(Args)> { };
+
+/**
+ * Callable lua object
+ *
+ * Copies share single block with registry slot and name of the function, so copying
+ * is just an atomic increment.
+ */
 class Function
 {
 public:
 	Function(impl::Reference && ref_, const std::string & name_, Error & error):
-		ref(ref_),
-		name(name_)
+		ref(checked(std::move(ref_), error), Label { name_, "function " + name_ }),
+		pinned(0)
 	{
-		error = Error::noError();
+		if(!error)
+			error = error.in(getSubject());
+	}
 
-		auto state = ref_.getState();
-		smartlua::Stack stack(ref.getState());
-		int pos = stack.size();
+	/**
+	 * Copy is never pinned, as it may outlive the scope pinning the original
+	 */
+	Function(const Function & other):
+		ref(other.ref),
+		limit(other.limit),
+		message(other.message),
+		pinned(0)
+	{ }
 
-		if(ref)
-		{
-			ref.push();
-			if(!lua_isfunction(state, -1))
-			{
-				lua_getmetatable(state, -1);
-				lua_pushstring(state, "__call");
-				lua_rawget(state, -2);
-				if(!lua_isfunction(state, -1))
-				{
-					ref.invalidate();
-					error = Error::badReference(
-						"function " + name,
-						"function",
-						lua_typename(state, lua_type(state, -3)));
-				}
-			}
-		}
+	Function & operator =(const Function & other)
+	{
+		ref = other.ref;
+		limit = other.limit;
+		message = other.message;
+		pinned = 0;
+		return *this;
+	}
+
+	Function(Function && other) noexcept:
+		ref(std::move(other.ref)),
+		limit(other.limit),
+		message(std::move(other.message)),
+		pinned(0)
+	{ }
 
-		stack.size(pos);
+	Function & operator =(Function && other) noexcept
+	{
+		ref = std::move(other.ref);
+		limit = other.limit;
+		message = std::move(other.message);
+		pinned = 0;
+		return *this;
 	}
 
 	operator bool() const { return ref; }
-	const std::string getName() { return name; }
+	const std::string & getName() const { return ref.payload().name; }
+	/**
+	 * \return Description of function for errors, generic one for moved-from handle
+	 */
+	const char * getSubject() const
+	{
+		const std::string & subject = ref.payload().subject;
+		return subject.empty() ? "function" : subject.c_str();
+	}
+	lua_State * getState() { return ref.getState(); }
 
+	/**
+	 * \param limit_ Budget of every following call, empty to run calls without hook
+	 */
+	void setLimit(const ExecutionLimit & limit_) { limit = limit_; }
+	const ExecutionLimit & getLimit() const { return limit; }
+
+	/**
+	 * Calls function within given frame
+	 *
+	 * On success results are left in frame just above its base, on failure the error
+	 * message is left there instead. In both cases they are removed with the frame.
+	 *
+	 * \param frame Frame created on state of this function
+	 * \param retc Number of expected results or LUA_MULTRET
+	 */
 	template<class... Args>
-	std::tuple<lua_State *, Error> operator()(int retc, Args... args)
+	Error operator()(CallFrame & frame, int retc, Args &&... args)
 	{
 		if(!ref)
 		{
-			return
-			std::make_tuple(
-				ref.getState(),
-				Error::emptyReferenceUsage(
-					"function " + name,
-					"function call")
-			);
+			return Error::emptyReferenceUsage("function call").in(getSubject());
 		}
 
-		smartlua::Stack stack(ref.getState());
-		ref.push();
+		if(pinned)
+			lua_pushvalue(frame.getState(), pinned);
+		else
+			ref.push();
+		frame.push(std::forward<Args>(args)...);
+		int status;
+		if(limit)
+		{
+			LimitHook hook(frame.getState(), limit);
+			if(!hook.isInstalled())
+				return Error::memoryError().in(getSubject());
+			status = frame.call(sizeof...(Args), retc);
+			// nested call may exhaust the budget right before returning
+			if(hook.isExceeded())
+				return Error::timeoutError().in(getSubject());
+		}
+		else
+		{
+			status = frame.call(sizeof...(Args), retc);
+		}
+
+		if(status == LUA_ERRMEM)
+			return Error::memoryError().in(getSubject());
+		if(status != LUA_OK)
+		{
+			return Error::runtimeError(
+				message.pin(frame.getState(), -1)).in(getSubject());
+		}
+
+		return Error::noError();
+	}
+
+	/**
+	 * Points runtime error at message kept by this handle
+	 *
+	 * Error stored next to the handle still points at message of the original handle
+	 * after both are copied, so it has to be rebound before its message is read.
+	 */
+	Error own(Error error) const
+	{
+		if(error.detail)
+			error.detail = message.get();
+		return error;
+	}
+
+	/**
+	 * Pushes function on given thread of its state
+	 */
+	void pushOn(lua_State * thread) const
+	{
+		lua_rawgeti(thread, LUA_REGISTRYINDEX, ref.view().getRef());
+	}
+
+	/**
+	 * Calls function with element of batch as its arguments
+	 *
+	 * Tuples are unpacked into separate arguments, any other element is passed as
+	 * single argument.
+	 */
+	template<class Item>
+	Error callWith(CallFrame & frame, int retc, const Item & item)
+	{
+		return (*this)(frame, retc, item);
+	}
+
+	template<class... Args>
+	Error callWith(CallFrame & frame, int retc, const std::tuple<Args...> & item)
+	{
+		return std::apply([&](const Args &... args) {
+			return (*this)(frame, retc, args...);
+		}, item);
+	}
 
-		pushArgs(args...);
-		if(lua_pcall(ref.getState(), sizeof...(Args), retc, 0))
+	/**
+	 * Makes sure that stack can fit the function and arguments from batch element, so
+	 * it doesn't have to be grown on every call
+	 */
+	template<class Item>
+	void reserve()
+	{
+		if(ref)
+			lua_checkstack(ref.getState(), BatchArity<Item>::value + 1);
+	}
+
+	/**
+	 * Pushes function on top of the stack and uses this slot for further calls
+	 *
+	 * \return Previously pinned slot, to be restored with unpin
+	 */
+	int pin()
+	{
+		int previous = pinned;
+		if(ref)
 		{
-			auto e = Error::runtimeError(
-				"function " + name,
-				stack.get<std::string>());
-			stack.pop();
-			return std::make_tuple(ref.getState(), e);
+			ref.push();
+			pinned = lua_gettop(ref.getState());
 		}
+		return previous;
+	}
 
-		return std::make_tuple(ref.getState(), Error::noError());
+	/**
+	 * Stops using pinned slot, the slot itself is not popped
+	 *
+	 * \param previous Slot returned by matching pin
+	 */
+	void unpin(int previous)
+	{
+		pinned = previous;
 	}
 
 private:
-	void pushArgs() { }
+	struct Label
+	{
+		std::string name;
+		std::string subject;
+	};
 
-	template<class Head, class... Tail>
-	void pushArgs(Head head, Tail... tail)
+	/**
+	 * \return Reference if it points to callable object, empty reference otherwise
+	 */
+	static Reference checked(Reference && ref, Error & error)
 	{
-		smartlua::Stack(ref.getState()).push(head);
-		pushArgs(tail...);
+		error = Error::noError();
+		if(!ref)
+			return std::move(ref);
+
+		auto state = ref.getState();
+		CallFrame frame(state);
+
+		ref.push();
+		if(!lua_isfunction(state, -1))
+		{
+			int type = lua_type(state, -1);
+			bool callable = false;
+			if(lua_getmetatable(state, -1))
+			{
+				lua_pushstring(state, "__call");
+				lua_rawget(state, -2);
+				callable = lua_isfunction(state, -1);
+			}
+
+			if(!callable)
+			{
+				ref.invalidate();
+				error = Error::badReference(LUA_TFUNCTION, type);
+			}
+		}
+		return std::move(ref);
 	}
 
-	impl::Reference ref;
-	std::string name;
+	BasicSharedReference<Label> ref;
+	ExecutionLimit limit;
+	ErrorMessage message;
+	int pinned;
 };
 
 } }
@@ -0,0 +1,87 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#pragma once
+
+#include "../ExecutionLimit.hpp"
+#include "../Function.hpp"
+#include "Reference.hpp"
+
+#include <lua.hpp>
+
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+
+namespace smartlua { namespace impl
+{
+
+/**
+ * Handles to global functions of single state, kept by name and result type
+ *
+ * Function is looked up on its first call only, and the handle is reused by later
+ * calls, even if the function was not found. Every handle gets the same limit. Has
+ * to be destroyed before the state.
+ */
+class FunctionCache
+{
+public:
+	FunctionCache(lua_State * state_, const ExecutionLimit & limit_ = ExecutionLimit()):
+		state(state_),
+		limit(limit_)
+	{ }
+
+	FunctionCache(const FunctionCache &) = delete;
+	FunctionCache & operator =(const FunctionCache &) = delete;
+
+	template<class R>
+	smartlua::Function<R> & get(const std::string & name)
+	{
+		auto & handles = byType[std::type_index(typeid(R))];
+		auto found = handles.find(name);
+		if(found == handles.end())
+		{
+			found = handles.emplace(name, std::make_unique<Handle<R>>(state, name)).first;
+			static_cast<Handle<R> &>(*found->second).function.setLimit(limit);
+		}
+		return static_cast<Handle<R> &>(*found->second).function;
+	}
+
+private:
+	struct HandleBase
+	{
+		virtual ~HandleBase() = default;
+	};
+
+	template<class R>
+	struct Handle: HandleBase
+	{
+		Handle(lua_State * state, const std::string & name):
+			function(Reference::createFromGlobal(state, name.c_str()), name)
+		{ }
+
+		smartlua::Function<R> function;
+	};
+
+	lua_State * state;
+	ExecutionLimit limit;
+	std::unordered_map<std::type_index, std::unordered_map<std::string, std::unique_ptr<HandleBase>>> byType;
+};
+
+} }
@@ -0,0 +1,315 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "../Stack.hpp"
+
+#include <lua.hpp>
+
+#include <cstdio>
+#include <exception>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace smartlua { namespace impl
+{
+
+/**
+ * Arguments of C++ function called from lua, unpacked from consecutive stack slots
+ */
+template<class... Args>
+struct Arguments
+{
+	typedef std::tuple<typename std::decay<Args>::type...> Values;
+
+	/**
+	 * True if arguments can be extracted into local values in single pass
+	 */
+	static constexpr bool extractable = (std::is_default_constructible<typename std::decay<Args>::type>::value && ...);
+
+	/**
+	 * Checks if all arguments on stack are compatible with expected types
+	 *
+	 * \param first Stack index of first argument
+	 * \return Stack index of first incompatible argument, 0 if all are compatible
+	 */
+	static int check([[maybe_unused]] lua_State * state, int first)
+	{
+		int idx = first;
+		bool compatible = ((Stack<typename std::decay<Args>::type>::is(state, idx) ? (++idx, true) : false) && ...);
+		return compatible ? 0 : idx;
+	}
+
+	/**
+	 * Calls function with arguments extracted from stack
+	 *
+	 * \param first Stack index of first argument
+	 */
+	template<class F>
+	static decltype(auto) call(lua_State * state, int first, F && f)
+	{
+		return call(state, first, std::forward<F>(f), std::index_sequence_for<Args...>());
+	}
+
+	/**
+	 * Checks and extracts all arguments in single pass, stopping on first mismatch
+	 *
+	 * \param first Stack index of first argument
+	 * \param values[out] Extracted arguments
+	 * \return Stack index of first incompatible argument, 0 if all are extracted
+	 */
+	static int extract(lua_State * state, int first, Values & values)
+	{
+		return extract(state, first, values, std::index_sequence_for<Args...>());
+	}
+
+	/**
+	 * Calls function with extracted arguments
+	 *
+	 * Arguments are passed as lvalues to lvalue reference parameters, and moved to the
+	 * others.
+	 */
+	template<class F>
+	static decltype(auto) apply(F && f, Values & values)
+	{
+		return apply(std::forward<F>(f), values, std::index_sequence_for<Args...>());
+	}
+
+private:
+	/**
+	 * \return Argument cast to type of parameter, like std::forward
+	 */
+	template<class Arg, class T>
+	static Arg && pass(T && value)
+	{
+		return static_cast<Arg &&>(value);
+	}
+
+	template<class F, std::size_t... I>
+	static decltype(auto) apply(F && f, [[maybe_unused]] Values & values, std::index_sequence<I...>)
+	{
+		return f(pass<Args>(std::get<I>(values))...);
+	}
+
+	template<std::size_t... I>
+	static int extract([[maybe_unused]] lua_State * state, [[maybe_unused]] int first,
+		[[maybe_unused]] Values & values, std::index_sequence<I...>)
+	{
+		int failed = 0;
+		static_cast<void>(((Stack<typename std::decay<Args>::type>::safeGet(state, std::get<I>(values), first + static_cast<int>(I)) ?
+			true : (failed = first + static_cast<int>(I), false)) && ...));
+		return failed;
+	}
+
+	template<class F, std::size_t... I>
+	static decltype(auto) call([[maybe_unused]] lua_State * state, [[maybe_unused]] int first,
+		F && f, std::index_sequence<I...>)
+	{
+		return f(pass<Args>(Stack<typename std::decay<Args>::type>::get(state, first + static_cast<int>(I)))...);
+	}
+};
+
+/**
+ * Results of C++ function called from lua
+ *
+ * Result is kept in value of Held type between the call and pushing it, so the
+ * arguments can be destroyed in between. References are copied, as they may point
+ * to the arguments.
+ */
+template<class R>
+struct Results
+{
+	typedef typename std::decay<R>::type Held;
+
+	template<class F>
+	static Held call(F && f)
+	{
+		return f();
+	}
+
+	/**
+	 * \return Number of pushed results
+	 */
+	static int push(lua_State * state, const Held & result)
+	{
+		Stack<Held>::push(state, result);
+		return 1;
+	}
+};
+
+/**
+ * Tuple is returned as multiple results
+ */
+template<class... Rs>
+struct Results<std::tuple<Rs...>>
+{
+	typedef std::tuple<typename std::decay<Rs>::type...> Held;
+
+	template<class F>
+	static Held call(F && f)
+	{
+		return f();
+	}
+
+	static int push(lua_State * state, const Held & result)
+	{
+		std::apply([state](auto &&... results) {
+			(Stack<typename std::decay<Rs>::type>::push(state, results), ...);
+		}, result);
+		return sizeof...(Rs);
+	}
+};
+
+template<>
+struct Results<void>
+{
+	struct Held { };
+
+	template<class F>
+	static Held call(F && f)
+	{
+		f();
+		return Held();
+	}
+
+	static int push(lua_State *, const Held &)
+	{
+		return 0;
+	}
+};
+
+/**
+ * Body of lua_CFunction calling C++ function
+ *
+ * Arguments are extracted or checked before the call, and on type mismatch lua error
+ * is raised only after all of them are destroyed. Results are pushed only after the
+ * arguments are destroyed as well, so longjmp never skips their destructors, even if
+ * pushing fails on memory error. Such error still skips destructor of the result
+ * being pushed. Arguments which can be default constructed are checked and extracted
+ * in single pass, others are checked first and extracted on call. C++ exceptions are
+ * converted to lua errors, as they can't be propagated through lua. Their messages
+ * are copied, up to MESSAGE_SIZE bytes, and raised after the exception and the
+ * arguments are destroyed.
+ */
+template<class R, class... Args>
+struct Invoker
+{
+	static constexpr std::size_t MESSAGE_SIZE = 256;
+
+	/**
+	 * \param first Stack index of first argument
+	 * \param f Function to call with extracted arguments
+	 * \return Number of results pushed to lua stack
+	 */
+	template<class F>
+	static int call(lua_State * state, int first, F && f)
+	{
+		if constexpr (Arguments<Args...>::extractable)
+			return callExtracted(state, first, f);
+		else
+			return callChecked(state, first, f);
+	}
+
+private:
+	typedef std::optional<typename Results<R>::Held> Result;
+
+	template<class F>
+	static int callExtracted(lua_State * state, int first, F & f)
+	{
+		Result result;
+		char message[MESSAGE_SIZE];
+		int failed = 0;
+		bool thrown = false;
+		{
+			typename Arguments<Args...>::Values values;
+			failed = Arguments<Args...>::extract(state, first, values);
+			if(!failed)
+				thrown = !protect(result, message, [&]() -> decltype(auto) {
+					return Arguments<Args...>::apply(f, values);
+				});
+		}
+
+		if(failed)
+			return argError(state, failed);
+
+		if(thrown)
+			return raise(state, message);
+
+		return Results<R>::push(state, *result);
+	}
+
+	template<class F>
+	static int callChecked(lua_State * state, int first, F & f)
+	{
+		if(int failed = Arguments<Args...>::check(state, first))
+			return argError(state, failed);
+
+		Result result;
+		char message[MESSAGE_SIZE];
+		if(!protect(result, message, [&]() -> decltype(auto) {
+				return Arguments<Args...>::call(state, first, f);
+			}))
+			return raise(state, message);
+
+		return Results<R>::push(state, *result);
+	}
+
+	/**
+	 * Calls function keeping its result, converting C++ exception to error message
+	 *
+	 * Nothing is pushed here, as memory error raised by lua would skip destructor of
+	 * the exception.
+	 *
+	 * \param result[out] Result of the call
+	 * \param message[out] Message of thrown exception
+	 * \return False if exception was thrown
+	 */
+	template<class F>
+	static bool protect(Result & result, char (&message)[MESSAGE_SIZE], F && f)
+	{
+		try
+		{
+			result.emplace(Results<R>::call(std::forward<F>(f)));
+			return true;
+		}
+		catch(std::exception & e)
+		{
+			std::snprintf(message, MESSAGE_SIZE, "%s", e.what());
+		}
+		catch(...)
+		{
+			std::snprintf(message, MESSAGE_SIZE, "%s", "unknown C++ exception");
+		}
+		return false;
+	}
+
+	static int raise(lua_State * state, const char * message)
+	{
+		lua_pushstring(state, message);
+		return lua_error(state);
+	}
+
+	static int argError(lua_State * state, int idx)
+	{
+		return luaL_argerror(state, idx,
+			lua_pushfstring(state, "unexpected %s", luaL_typename(state, idx)));
+	}
+};
+
+} }
@@ -0,0 +1,72 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include <lua.hpp>
+
+namespace smartlua { namespace impl
+{
+
+/**
+ * Metatable shared by all userdata of given C++ type
+ *
+ * Metatable is created once per lua state on first use and kept in registry under
+ * address unique for the type, so it is found with single lua_rawgetp, without
+ * any string hashing.
+ */
+template<class T>
+class Metatable
+{
+public:
+	/**
+	 * Pushes metatable of the type to lua stack
+	 *
+	 * \param init Function filling newly created metatable on top of stack, called
+	 * only once per lua state
+	 */
+	template<class Init>
+	static void push(lua_State * state, Init init)
+	{
+		if(lua_rawgetp(state, LUA_REGISTRYINDEX, &key) == LUA_TTABLE)
+			return;
+
+		lua_pop(state, 1);
+		lua_newtable(state);
+		init(state);
+		lua_pushvalue(state, -1);
+		lua_rawsetp(state, LUA_REGISTRYINDEX, &key);
+	}
+
+	/**
+	 * Checks if value on lua stack has metatable of the type
+	 */
+	static bool is(lua_State * state, int idx)
+	{
+		if(!lua_getmetatable(state, idx))
+			return false;
+
+		lua_rawgetp(state, LUA_REGISTRYINDEX, &key);
+		bool result = lua_rawequal(state, -1, -2);
+		lua_pop(state, 2);
+		return result;
+	}
+
+private:
+	static inline const char key = 0;
+};
+
+} }
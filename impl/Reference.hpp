@@ -18,6 +18,8 @@
 
 #include <lua.hpp>
 
+#include <utility>
+
 namespace smartlua { namespace impl
 {
 
@@ -40,44 +42,52 @@ public:
 	{ }
 
 	Reference(const Reference & other):
-		state(other.state)
+		state(other.state),
+		ref(LUA_NOREF)
 	{
-		lua_rawgeti(state, LUA_REGISTRYINDEX, other.ref);
-		ref = luaL_ref(state, LUA_REGISTRYINDEX);
+		if(other)
+		{
+			lua_rawgeti(state, LUA_REGISTRYINDEX, other.ref);
+			ref = luaL_ref(state, LUA_REGISTRYINDEX);
+		}
 	}
 
-	Reference(Reference && other):
-		Reference(other.state)
+	Reference(Reference && other) noexcept:
+		state(other.state),
+		ref(other.ref)
 	{
-		std::swap(ref, other.ref);
+		other.ref = LUA_NOREF;
 	}
 
 	~Reference()
 	{
-		luaL_unref(state, LUA_REGISTRYINDEX, ref);
+		if(*this)
+			luaL_unref(state, LUA_REGISTRYINDEX, ref);
 	}
 
 	Reference & operator =(const Reference & other)
 	{
-		luaL_unref(state, LUA_REGISTRYINDEX, ref);
-		state = other.state;
-		lua_rawgeti(state, LUA_REGISTRYINDEX, other.ref);
-		ref = luaL_ref(state, LUA_REGISTRYINDEX);
-		lua_pop(state, 1);
+		Reference copy(other);
+		std::swap(state, copy.state);
+		std::swap(ref, copy.ref);
 		return *this;
 	}
 
-	Reference & operator=(Reference && other)
+	Reference & operator=(Reference && other) noexcept
 	{
 		std::swap(state, other.state);
 		std::swap(ref, other.ref);
 		return *this;
 	}
 
-	lua_State * getState() { return state; }
-	const lua_State * getState() const { return state; }
+	lua_State * getState() const { return state; }
+
+	/**
+	 * \return Registry index of referenced object, LUA_NOREF if empty
+	 */
+	int getRef() const { return ref; }
 
-	void push()
+	void push() const
 	{
 		lua_rawgeti(state, LUA_REGISTRYINDEX, ref);
 	}
@@ -89,7 +99,8 @@ public:
 
 	void invalidate()
 	{
-		luaL_unref(state, LUA_REGISTRYINDEX, ref);
+		if(*this)
+			luaL_unref(state, LUA_REGISTRYINDEX, ref);
 		ref = LUA_NOREF;
 	}
 
@@ -98,12 +109,10 @@ public:
 		return Reference(state, luaL_ref(state, LUA_REGISTRYINDEX));
 	}
 
-	static Reference createFromGlobal(lua_State * state, const std::string & name)
+	static Reference createFromGlobal(lua_State * state, const char * name)
 	{
-		lua_getglobal(state, name.c_str());
-		auto result = createFromStack(state);
-		lua_pop(state, 1);
-		return result;
+		lua_getglobal(state, name);
+		return createFromStack(state);
 	}
 
 private:
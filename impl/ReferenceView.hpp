@@ -0,0 +1,63 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "Reference.hpp"
+
+#include <lua.hpp>
+
+namespace smartlua { namespace impl
+{
+
+/**
+ * Non-owning handle to lua object kept alive by some Reference
+ *
+ * Copying the view never touches lua, but it's valid only as long as the reference
+ * it was taken from is alive, so it is meant to be passed down the call stack and not
+ * stored.
+ */
+class ReferenceView
+{
+public:
+	ReferenceView(lua_State * state_, int ref_):
+		state(state_),
+		ref(ref_)
+	{ }
+
+	ReferenceView(const Reference & ref_):
+		ReferenceView(ref_.getState(), ref_.getRef())
+	{ }
+
+	lua_State * getState() const { return state; }
+	int getRef() const { return ref; }
+
+	void push() const
+	{
+		lua_rawgeti(state, LUA_REGISTRYINDEX, ref);
+	}
+
+	operator bool() const
+	{
+		return ref != LUA_NOREF;
+	}
+
+private:
+	lua_State * state;
+	int ref;
+};
+
+} }
@@ -0,0 +1,164 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "Reference.hpp"
+#include "ReferenceView.hpp"
+
+#include <lua.hpp>
+
+#include <atomic>
+#include <type_traits>
+#include <utility>
+
+namespace smartlua { namespace impl
+{
+
+/**
+ * No data shared along with reference
+ */
+struct NoPayload { };
+
+/**
+ * Reference to lua object shared between its copies
+ *
+ * Single registry slot is kept for all copies, so copying is just an atomic increment
+ * of the counter and never calls lua. The slot is released when the last copy is
+ * destroyed, which, as for Reference, has to happen while the state is open and not
+ * used concurrently.
+ *
+ * Payload is immutable data kept in the same shared block, like name of referenced
+ * function, so it's not copied with the reference either. Block with non-empty
+ * payload is created even for empty reference, so payload is available until the
+ * reference is moved from.
+ */
+template<class Payload = NoPayload>
+class BasicSharedReference
+{
+public:
+	BasicSharedReference(lua_State * state_):
+		state(state_),
+		shared(nullptr)
+	{ }
+
+	BasicSharedReference(Reference && ref, Payload payload = Payload()):
+		state(ref.getState()),
+		shared(ref || !std::is_empty<Payload>::value ?
+			new Shared(std::move(ref), std::move(payload)) : nullptr)
+	{ }
+
+	BasicSharedReference(const BasicSharedReference & other):
+		state(other.state),
+		shared(other.shared)
+	{
+		if(shared)
+			shared->count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	BasicSharedReference(BasicSharedReference && other) noexcept:
+		state(other.state),
+		shared(other.shared)
+	{
+		other.shared = nullptr;
+	}
+
+	~BasicSharedReference()
+	{
+		release();
+	}
+
+	BasicSharedReference & operator =(const BasicSharedReference & other)
+	{
+		BasicSharedReference copy(other);
+		std::swap(state, copy.state);
+		std::swap(shared, copy.shared);
+		return *this;
+	}
+
+	BasicSharedReference & operator =(BasicSharedReference && other) noexcept
+	{
+		std::swap(state, other.state);
+		std::swap(shared, other.shared);
+		return *this;
+	}
+
+	lua_State * getState() const { return state; }
+
+	/**
+	 * \return Non-owning view valid as long as this reference is not released
+	 */
+	ReferenceView view() const
+	{
+		return ReferenceView(state, shared ? shared->ref.getRef() : LUA_NOREF);
+	}
+
+	void push() const
+	{
+		view().push();
+	}
+
+	operator bool() const
+	{
+		return shared && shared->ref;
+	}
+
+	/**
+	 * \return Payload shared by copies, default constructed one if this copy was moved
+	 * from or invalidated, or if payload is empty and reference is not set
+	 */
+	const Payload & payload() const
+	{
+		static const Payload none = Payload();
+		return shared ? shared->payload : none;
+	}
+
+	/**
+	 * Releases this copy, referenced object is kept alive by other copies
+	 */
+	void invalidate()
+	{
+		release();
+		shared = nullptr;
+	}
+
+private:
+	struct Shared
+	{
+		Shared(Reference && ref_, Payload && payload_):
+			ref(std::move(ref_)),
+			payload(std::move(payload_)),
+			count(1)
+		{ }
+
+		Reference ref;
+		Payload payload;
+		std::atomic<unsigned> count;
+	};
+
+	void release()
+	{
+		if(shared && shared->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete shared;
+	}
+
+	lua_State * state;
+	Shared * shared;
+};
+
+typedef BasicSharedReference<> SharedReference;
+
+} }
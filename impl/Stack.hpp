@@ -16,29 +16,51 @@
 
 #pragma once
 
+#include "Metatable.hpp"
 #include "../Error.hpp"
 
 #include  <lua.hpp>
 
-#include <boost/format.hpp>
+#include <type_traits>
+#include <new>
+#include <utility>
 
 namespace smartlua { namespace impl
 {
 
+/**
+ * Any C++ object stored as full userdata
+ *
+ * All userdata of the same type share single metatable, created on first push.
+ */
 template<class T, class E=void>
 struct Stack
 {
 	static void push(lua_State * state, const T & val)
+	{
+		emplace(state, val);
+	}
+
+	/**
+	 * Constructs object directly in new userdata
+	 */
+	template<class... Args>
+	static void emplace(lua_State * state, Args &&... args)
 	{
 		T * ptr = static_cast<T *>(lua_newuserdata(state, sizeof(T)));
-		new(ptr) T(val);
-		lua_createtable(state, 0, 1);
-		lua_pushstring(state, "__gc");
-		lua_pushcclosure(state, &Stack<T>::gc, 0);
-		lua_settable(state, -3);
+		new(ptr) T(std::forward<Args>(args)...);
+		pushMetatable(state);
 		lua_setmetatable(state, -2);
 	}
 
+	/**
+	 * Pushes metatable shared by all userdata of this type
+	 */
+	static void pushMetatable(lua_State * state)
+	{
+		Metatable<T>::push(state, &init);
+	}
+
 	static T get(lua_State * state, int idx)
 	{
 		return *static_cast<T *>(lua_touserdata(state, idx));
@@ -46,28 +68,49 @@ struct Stack
 
 	static bool is(lua_State * state, int idx)
 	{
-		return lua_isuserdata(state, idx) || lua_islightuserdata(state, idx);
+		return lua_type(state, idx) == LUA_TUSERDATA && Metatable<T>::is(state, idx);
 	}
 
-	template<class U=T>
-	static bool safe_get(lua_State * state, U & result, int idx)
+	static Error safeGet(lua_State * state, T & result, int idx)
 	{
-		if(!(lua_isuserdata(state, idx) || lua_islightuserdata(state, idx)))
-			return Error::stackError(
-				(boost::format("expected userdata, %1% found")
-				% lua_typename(state, lua_type(state, idx))).str());
+		if(!is(state, idx))
+			return Error::stackError(LUA_TUSERDATA, lua_type(state, idx));
 
-		result = *static_cast<T>(lua_touserdata(state, idx));
+		result = *static_cast<T *>(lua_touserdata(state, idx));
 		return Error::noError();
 	}
 
 private:
+	static void init(lua_State * state)
+	{
+		lua_pushcfunction(state, &gc);
+		lua_setfield(state, -2, "__gc");
+	}
+
+	/**
+	 * Destroys object in place, memory itself is owned and freed by lua
+	 */
 	static int gc(lua_State * state)
 	{
-		T * ptr = lua_touserdata(state, -1);
-		delete ptr;
+		static_cast<T *>(lua_touserdata(state, 1))->~T();
 		return 0;
 	}
 };
 
+/**
+ * Checks if type can be extracted from lua stack with checking
+ *
+ * Every specialization of Stack provides
+ * `static Error safeGet(lua_State * state, T & result, int idx)`, which on success
+ * extracts value directly into `result`, and on failure leaves stack unchanged and
+ * returns error describing the mismatch.
+ */
+template<class T, class E=void>
+struct is_extractable: std::false_type { };
+
+template<class T>
+struct is_extractable<T, typename std::enable_if<std::is_same<
+	decltype(Stack<T>::safeGet(std::declval<lua_State *>(), std::declval<T &>(), 0)),
+	Error>::value>::type>: std::true_type { };
+
 } }
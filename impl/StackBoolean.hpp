@@ -44,13 +44,10 @@ struct Stack<bool>
 		return lua_isboolean(state, idx);
 	}
 
-	template<class U>
-	static bool safe_get(lua_State * state, U & result, int idx)
+	static Error safeGet(lua_State * state, bool & result, int idx)
 	{
 		if(!lua_isboolean(state, idx))
-			return Error::stackError(
-				(boost::format("expected boolean, %1% found")
-				% lua_typename(state, lua_type(state, idx))).str());
+			return Error::stackError(LUA_TBOOLEAN, lua_type(state, idx));
 
 		result = lua_toboolean(state, idx);
 		return Error::noError();
@@ -0,0 +1,153 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include "Stack.hpp"
+#include "Metatable.hpp"
+#include "Reference.hpp"
+#include "../Buffer.hpp"
+#include "../Error.hpp"
+
+#include <lua.hpp>
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+namespace smartlua { namespace impl
+{
+
+/**
+ * Header of buffer userdata
+ *
+ * For buffers owning their memory elements are stored in the same userdata right
+ * after the header.
+ */
+template<class T>
+struct BufferUserdata
+{
+	T * data;
+	std::size_t size;
+
+	static BufferUserdata * create(lua_State * state, T * data, std::size_t size)
+	{
+		auto ud = static_cast<BufferUserdata *>(lua_newuserdata(state, sizeof(BufferUserdata)));
+		ud->data = data;
+		ud->size = size;
+		Metatable<BufferUserdata>::push(state, &init);
+		lua_setmetatable(state, -2);
+		return ud;
+	}
+
+	static Buffer<T> allocate(lua_State * state, std::size_t size)
+	{
+		auto ud = static_cast<BufferUserdata *>(lua_newuserdata(state, sizeof(BufferUserdata) + size * sizeof(T)));
+		ud->data = reinterpret_cast<T *>(ud + 1);
+		ud->size = size;
+		std::memset(ud->data, 0, size * sizeof(T));
+		Metatable<BufferUserdata>::push(state, &init);
+		lua_setmetatable(state, -2);
+		return Buffer<T>(ud->data, size, Reference::createFromStack(state));
+	}
+
+private:
+	static void init(lua_State * state)
+	{
+		lua_pushcfunction(state, &index);
+		lua_setfield(state, -2, "__index");
+		lua_pushcfunction(state, &newindex);
+		lua_setfield(state, -2, "__newindex");
+		lua_pushcfunction(state, &len);
+		lua_setfield(state, -2, "__len");
+	}
+
+	static int index(lua_State * state)
+	{
+		auto ud = static_cast<BufferUserdata *>(lua_touserdata(state, 1));
+		int isnum;
+		lua_Integer i = lua_tointegerx(state, 2, &isnum);
+		if(!isnum || i < 1 || static_cast<lua_Unsigned>(i) > ud->size)
+			return 0;
+
+		Stack<T>::push(state, ud->data[i - 1]);
+		return 1;
+	}
+
+	static int newindex(lua_State * state)
+	{
+		auto ud = static_cast<BufferUserdata *>(lua_touserdata(state, 1));
+		lua_Integer i = luaL_checkinteger(state, 2);
+		if(i < 1 || static_cast<lua_Unsigned>(i) > ud->size)
+			return luaL_argerror(state, 2, "buffer index out of range");
+
+		if(std::is_integral<T>::value)
+			ud->data[i - 1] = static_cast<T>(luaL_checkinteger(state, 3));
+		else
+			ud->data[i - 1] = static_cast<T>(luaL_checknumber(state, 3));
+		return 0;
+	}
+
+	static int len(lua_State * state)
+	{
+		auto ud = static_cast<BufferUserdata *>(lua_touserdata(state, 1));
+		lua_pushinteger(state, ud->size);
+		return 1;
+	}
+};
+
+template<class T>
+struct Stack<Buffer<T>>
+{
+	/**
+	 * Pushes buffer userdata
+	 *
+	 * Buffers already living in lua are pushed as the same userdata, views of C++
+	 * memory get a new userdata pointing to it. Elements are never copied. Userdata is
+	 * taken from registry directly, as given state may be other thread than the one
+	 * kept by reference.
+	 */
+	static void push(lua_State * state, const Buffer<T> & buffer)
+	{
+		if(buffer.isUserdata())
+			lua_rawgeti(state, LUA_REGISTRYINDEX, buffer.getReference().getRef());
+		else
+			BufferUserdata<T>::create(state, buffer.data(), buffer.size());
+	}
+
+	static Buffer<T> get(lua_State * state, int idx)
+	{
+		auto ud = static_cast<BufferUserdata<T> *>(lua_touserdata(state, idx));
+		lua_pushvalue(state, idx);
+		return Buffer<T>(ud->data, ud->size, Reference::createFromStack(state));
+	}
+
+	static bool is(lua_State * state, int idx)
+	{
+		return lua_type(state, idx) == LUA_TUSERDATA && Metatable<BufferUserdata<T>>::is(state, idx);
+	}
+
+	static Error safeGet(lua_State * state, Buffer<T> & result, int idx)
+	{
+		if(!is(state, idx))
+			return Error::stackError(LUA_TUSERDATA, lua_type(state, idx));
+
+		result = get(state, idx);
+		return Error::noError();
+	}
+};
+
+} }
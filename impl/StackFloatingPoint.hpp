@@ -14,6 +14,8 @@
  * copyrigt Bartłomiej Kuras, 2015
  */
 
+#pragma once
+
 #include "Stack.hpp"
 #include "../Error.hpp"
 
@@ -21,8 +23,6 @@
 
 #include <type_traits>
 
-#pragma once
-
 namespace smartlua { namespace impl
 {
 
@@ -44,15 +44,12 @@ struct Stack<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
 		return lua_isnumber(state, idx);
 	}
 
-	template<typename U=T>
-	static Error safeGet(lua_State * state, U & result, int idx)
+	static Error safeGet(lua_State * state, T & result, int idx)
 	{
 		if(!lua_isnumber(state, idx))
-			return Error::stackError(
-				(boost::format("expected floating point, %1% found")
-				% lua_typename(state, lua_type(state, idx))).str());
+			return Error::stackError(LUA_TNUMBER, lua_type(state, idx));
 
-		result = lua_tonumber(state, idx);
+		result = static_cast<T>(lua_tonumber(state, idx));
 		return Error::noError();
 	}
 };
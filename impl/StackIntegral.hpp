@@ -44,15 +44,12 @@ struct Stack<T, typename std::enable_if<std::is_integral<T>::value>::type>
 		return lua_isinteger(state, idx);
 	}
 
-	template<typename U=T>
-	static Error safeGet(lua_State * state, U & result, int idx)
+	static Error safeGet(lua_State * state, T & result, int idx)
 	{
 		if(!lua_isinteger(state, idx))
-			return Error::stackError(
-				(boost::format("expected integral, %1% found")
-				% lua_typename(state, lua_type(state, idx))).str());
+			return Error::stackError(Error::TINTEGER, lua_type(state, idx));
 
-		result = lua_tointeger(state, idx);
+		result = static_cast<T>(lua_tointeger(state, idx));
 		return Error::noError();
 	}
 };
@@ -24,173 +24,270 @@
 
 #include <type_traits>
 #include <iterator>
+#include <utility>
 
 namespace smartlua { namespace impl
 {
 
-template<class T, class E=void>
-struct is_iterable: std::false_type { };
-
-template<class T>
-struct is_iterable<T,
-	typename std::enable_if<std::is_pointer<decltype(&T::begin)>::value>::type>: std::true_type { };
-
 template<class T>
-struct Stack<T, typename std::enable_if<
-	!std::is_void<typename T::value_type>::value &&
-	!std::is_void<decltype(std::declval<T&>().begin())>::value &&
-	!std::is_void<decltype(std::declval<T&>().end())>::value
-	>::type>
+struct Stack<T, typename std::enable_if<utils::is_iterable_type<T>::value>::type>
 {
-	template<class U=T, void(
-		decltype(std::declval<U&>().size()),
-		typename std::enable_if<utils::is_luatable_type<U>::value>::type)>
-	static void push(lua_State * state, const U & val)
+	/**
+	 * Pushes key-value container as lua table with presized hash part
+	 */
+	template<class U=T>
+	static typename std::enable_if<utils::is_mapping_type<U>::value>::type
+	push(lua_State * state, const U & val)
 	{
-		lua_createtable(state, val.size(), 0);
-		int i = 1;
+		lua_createtable(state, 0, static_cast<int>(val.size()));
 		for(auto & item: val)
 		{
-			lua_pushinteger(state, i++);
-			Stack<typename U::value_type>::push(state, item);
-			lua_settable(state, -3);
+			Stack<typename U::key_type>::push(state, item.first);
+			Stack<typename U::mapped_type>::push(state, item.second);
+			lua_rawset(state, -3);
 		}
 	}
 
-	template<class U=T, void(
-		decltype(std::declval<U&>().size()),
-		typename std::enable_if<!utils::is_luatable_type<U>::value>::type)>
-	static void push(lua_State * state, const U & val)
+	/**
+	 * Pushes sequence as lua table with presized array part
+	 */
+	template<class U=T>
+	static typename std::enable_if<
+		!utils::is_mapping_type<U>::value &&
+		utils::has_size<U>::value>::type
+	push(lua_State * state, const U & val)
 	{
-		lua_createtable(state, 0, val.size());
-		int i = 1;
-		for(auto & item: val)
+		lua_createtable(state, static_cast<int>(val.size()), 0);
+		lua_Integer i = 1;
+		for(auto && item: val)
 		{
-			lua_pushinteger(state, i++);
 			Stack<typename U::value_type>::push(state, item);
-			lua_settable(state, -3);
+			lua_rawseti(state, -2, i++);
 		}
 	}
 
+	/**
+	 * Pushes sequence of unknown size as lua table
+	 */
 	template<class U=T>
-	static void push(lua_State * state, const U & val)
+	static typename std::enable_if<
+		!utils::is_mapping_type<U>::value &&
+		!utils::has_size<U>::value>::type
+	push(lua_State * state, const U & val)
 	{
 		lua_newtable(state);
-		int i = 1;
-		for(auto & item: val)
+		lua_Integer i = 1;
+		for(auto && item: val)
 		{
-			lua_pushinteger(state, i++);
 			Stack<typename U::value_type>::push(state, item);
-			lua_settable(state, -3);
+			lua_rawseti(state, -2, i++);
 		}
 	}
 
-	template<class U=T, class E=
-		decltype(std::inserter(std::declval<U&>(), std::declval<U&>().end()))>
-	static U get(lua_State * state, int idx)
+	static T get(lua_State * state, int idx)
 	{
-		idx = lua_absindex(state, idx);
-		U result;
-		auto it = std::inserter(result, result.end());
-		lua_pushinteger(state, 1);
-		lua_gettable(state, idx);
-		for(int i=2; !lua_isnil(state, -1); ++i)
-		{
-			it = Stack<typename U::value_type>::get(state, -1);
-			lua_pop(state, 1);
-			lua_pushinteger(state, i);
-			lua_gettable(state, idx);
-		}
-		lua_pop(state, 1);
+		T result;
+		read(state, result, lua_absindex(state, idx), Kind());
 		return result;
 	}
 
+	/**
+	 * Checks if table is compatible, stopping on first incompatible element
+	 *
+	 * If the value is extracted anyway, safeGet should be preferred, as it checks and
+	 * converts elements in the same traversal.
+	 */
 	static bool is(lua_State * state, int idx)
+	{
+		return lua_istable(state, idx) && check(state, lua_absindex(state, idx), Kind());
+	}
+
+	/**
+	 * Replaces content of container with table elements
+	 *
+	 * Storage already allocated by the container is reused where possible.
+	 */
+	static Error safeGet(lua_State * state, T & result, int idx)
 	{
 		if(!lua_istable(state, idx))
-			return false;
+			return Error::stackError(LUA_TTABLE, lua_type(state, idx));
+
+		return safeRead(state, result, lua_absindex(state, idx), Kind());
+	}
+
+private:
+	typedef typename T::value_type Value;
+
+	struct MappingKind { };
+	struct ContiguousKind { };
+	struct SequenceKind { };
 
-		idx = lua_absindex(state, idx);
-		lua_pushinteger(state, 1);
-		lua_gettable(state, idx);
-		for(int i=2; !lua_isnil(state, -1); ++i){
-			if(!Stack<typename T::value_type>::is(state, -1))
+	typedef typename std::conditional<utils::is_mapping_type<T>::value, MappingKind,
+		typename std::conditional<utils::is_contiguous_arithmetic_type<T>::value, ContiguousKind,
+			SequenceKind>::type>::type Kind;
+
+	template<class U>
+	static typename std::enable_if<utils::has_reserve<U>::value>::type
+	reserve(U & result, lua_Unsigned size) { result.reserve(size); }
+
+	template<class U>
+	static typename std::enable_if<!utils::has_reserve<U>::value>::type
+	reserve(U &, lua_Unsigned) { }
+
+	static bool check(lua_State * state, int idx, MappingKind)
+	{
+		lua_pushnil(state);
+		while(lua_next(state, idx))
+		{
+			if(!Stack<typename T::key_type>::is(state, -2) ||
+				!Stack<typename T::mapped_type>::is(state, -1))
 			{
-				lua_pop(state, 1);
+				lua_pop(state, 2);
 				return false;
 			}
 			lua_pop(state, 1);
-			lua_pushinteger(state, i);
 		}
-		lua_pop(state, 1);
 		return true;
 	}
 
-	template<class U, class E=typename std::enable_if<
-			!std::is_void<decltype(std::inserter(std::declval<T&>(), std::declval<T&>().end()))>::value &&
-			!std::is_same<U, T>::value>::type>
-	static bool safeGet(lua_State * state, U & result, int idx)
+	template<class K>
+	static bool check(lua_State * state, int idx, K)
 	{
-		if(!lua_istable(state, idx))
-			return Error::stackError(
-				(boost::format("expected iterable, %1% found")
-				% lua_typename(state, lua_type(state, idx))).str());
-
-		idx = lua_absindex(state, idx);
-		T tmpResult;
-		auto it = std::inserter(tmpResult, tmpResult.end());
-		lua_pushinteger(state, 1);
-		lua_gettable(state, idx);
-		for(int i=2; !lua_isnil(state, -1); ++i)
+		auto size = lua_rawlen(state, idx);
+		for(lua_Unsigned i = 1; i <= size; ++i)
 		{
-			auto e = Stack<typename T::value_type>::safe_get(state, it, -1);
-			if(!e)
-			{
-				e = Error::stackError(
-					(boost::format("iterable[%1%]") % (i - 1)).str(),
-					e.desc);
-				lua_pop(state, 1);
-				return e;
-			}
+			lua_rawgeti(state, idx, i);
+			bool result = Stack<Value>::is(state, -1);
 			lua_pop(state, 1);
-			lua_pushinteger(state, 1);
-			lua_gettable(state, idx);
+			if(!result)
+				return false;
 		}
-		lua_pop(state, 1);
-		result = std::move(tmpResult);
 		return true;
 	}
 
-	template<class E=decltype(std::inserter(std::declval<T&>(), std::declval<T&>().end()))>
-	static bool safeGet(lua_State * state, T & result, int idx)
+	static void read(lua_State * state, T & result, int idx, MappingKind)
 	{
-		if(!lua_istable(state, idx))
-			return Error::stackError(
-				(boost::format("expected iterable, %1% found")
-				% lua_typename(state, lua_type(state, idx))).str());
-
-		idx = lua_absindex(state, idx);
-		auto it = std::inserter(result, result.end());
-		lua_pushinteger(state, 1);
-		lua_gettable(state, idx);
-		for(int i=2; !lua_isnil(state, -1); ++i)
+		lua_pushnil(state);
+		while(lua_next(state, idx))
+		{
+			// key is copied, so converting it in place can't break the traversal
+			lua_pushvalue(state, -2);
+			result.emplace(
+				Stack<typename T::key_type>::get(state, -1),
+				Stack<typename T::mapped_type>::get(state, -2));
+			lua_pop(state, 2);
+		}
+	}
+
+	static void read(lua_State * state, T & result, int idx, ContiguousKind)
+	{
+		auto size = lua_rawlen(state, idx);
+		result.resize(size);
+		auto data = result.data();
+		for(lua_Unsigned i = 0; i < size; ++i)
+		{
+			lua_rawgeti(state, idx, i + 1);
+			data[i] = Stack<Value>::get(state, -1);
+			lua_pop(state, 1);
+		}
+	}
+
+	static void read(lua_State * state, T & result, int idx, SequenceKind)
+	{
+		auto size = lua_rawlen(state, idx);
+		reserve(result, size);
+		for(lua_Unsigned i = 1; i <= size; ++i)
+		{
+			lua_rawgeti(state, idx, i);
+			result.insert(result.end(), Stack<Value>::get(state, -1));
+			lua_pop(state, 1);
+		}
+	}
+
+	static Error safeRead(lua_State * state, T & result, int idx, MappingKind)
+	{
+		result.clear();
+		lua_pushnil(state);
+		while(lua_next(state, idx))
 		{
-			auto e = Stack<typename T::value_type>::safe_get(state, it, -1);
+			lua_pushvalue(state, -2);
+			typename T::key_type key;
+			auto e = Stack<typename T::key_type>::safeGet(state, key, -1);
+			if(!e)
+			{
+				lua_pop(state, 3);
+				return e.at(Error::Step::ITERABLE_KEY);
+			}
+
+			typename T::mapped_type value;
+			e = Stack<typename T::mapped_type>::safeGet(state, value, -2);
 			if(!e)
 			{
-				e = Error::stackError(
-					(boost::format("iterable[%1%]") % (i - 1)).str(),
-					e.desc);
-				lua_pop(state, 1);
-				return e;
+				lua_pop(state, 3);
+				return e.at(Error::Step::ITERABLE_VALUE);
 			}
+
+			result.emplace(std::move(key), std::move(value));
+			lua_pop(state, 2);
+		}
+		return Error::noError();
+	}
+
+	static Error safeRead(lua_State * state, T & result, int idx, ContiguousKind)
+	{
+		auto size = lua_rawlen(state, idx);
+		result.resize(size);
+		auto data = result.data();
+		for(lua_Unsigned i = 0; i < size; ++i)
+		{
+			lua_rawgeti(state, idx, i + 1);
+			auto e = Stack<Value>::safeGet(state, data[i], -1);
+			lua_pop(state, 1);
+			if(!e)
+				return e.at(Error::Step::ITERABLE, i + 1);
+		}
+		return Error::noError();
+	}
+
+	static Error safeRead(lua_State * state, T & result, int idx, SequenceKind)
+	{
+		result.clear();
+		auto size = lua_rawlen(state, idx);
+		reserve(result, size);
+		for(lua_Unsigned i = 1; i <= size; ++i)
+		{
+			lua_rawgeti(state, idx, i);
+			auto e = safeReadItem(state, result);
 			lua_pop(state, 1);
-			lua_pushinteger(state, i);
-			lua_gettable(state, idx);
+			if(!e)
+				return e.at(Error::Step::ITERABLE, i);
 		}
-		lua_pop(state, 1);
 		return Error::noError();
 	}
+
+	/**
+	 * Extracts element from top of the stack directly into new slot at the end of sequence
+	 */
+	template<class U>
+	static typename std::enable_if<utils::has_emplace_back<U>::value, Error>::type
+	safeReadItem(lua_State * state, U & result)
+	{
+		auto e = Stack<Value>::safeGet(state, result.emplace_back(), -1);
+		if(!e)
+			result.pop_back();
+		return e;
+	}
+
+	template<class U>
+	static typename std::enable_if<!utils::has_emplace_back<U>::value, Error>::type
+	safeReadItem(lua_State * state, U & result)
+	{
+		Value item;
+		auto e = Stack<Value>::safeGet(state, item, -1);
+		if(e)
+			result.insert(result.end(), std::move(item));
+		return e;
+	}
 };
 
 } }
@@ -34,7 +34,7 @@ struct Stack<T*>
 		lua_pushlightuserdata(state, static_cast<void*>(val));
 	}
 
-	static bool get(lua_State * state, int idx)
+	static T * get(lua_State * state, int idx)
 	{
 		return static_cast<T*>(lua_touserdata(state, idx));
 	}
@@ -44,13 +44,10 @@ struct Stack<T*>
 		return lua_islightuserdata(state, idx) || lua_isuserdata(state, idx);
 	}
 
-	template<class U>
-	static Error safe_get(lua_State * state, U & result, int idx)
+	static Error safeGet(lua_State * state, T * & result, int idx)
 	{
 		if(!(lua_islightuserdata(state, idx) || lua_isuserdata(state, idx)))
-			return Error::stackError(
-				(boost::format("expected pointer, %1% found")
-				% lua_typename(state, lua_type(state, idx))).str());
+			return Error::stackError(LUA_TLIGHTUSERDATA, lua_type(state, idx));
 
 		result = static_cast<T*>(lua_touserdata(state, idx));
 		return Error::noError();
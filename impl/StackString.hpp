@@ -17,11 +17,14 @@
 #pragma once
 
 #include "Stack.hpp"
+#include "Reference.hpp"
+#include "../BorrowedString.hpp"
 #include "../Error.hpp"
 
 #include <lua.hpp>
 
 #include <string>
+#include <string_view>
 
 namespace smartlua { namespace impl
 {
@@ -31,12 +34,14 @@ struct Stack<std::string>
 {
 	static void push(lua_State * state, const std::string & str)
 	{
-		lua_pushstring(state, str.c_str());
+		lua_pushlstring(state, str.data(), str.size());
 	}
 
 	static std::string get(lua_State * state, int idx)
 	{
-		return lua_tostring(state, idx);
+		std::size_t len;
+		const char * str = lua_tolstring(state, idx, &len);
+		return std::string(str, len);
 	}
 
 	static bool is(lua_State * state, int idx)
@@ -44,15 +49,83 @@ struct Stack<std::string>
 		return lua_isstring(state, idx);
 	}
 
-	template<class U>
-	static Error safe_get(lua_State * state, U & str, int idx)
+	static Error safeGet(lua_State * state, std::string & str, int idx)
 	{
 		if(!lua_isstring(state, idx))
-			return Error::stackError(
-				(boost::format("expected string, %1% found")
-				% lua_typename(state, lua_type(state, idx))).str());
+			return Error::stackError(LUA_TSTRING, lua_type(state, idx));
 
-		str = lua_tostring(state, idx);
+		str = get(state, idx);
+		return Error::noError();
+	}
+};
+
+/**
+ * View of lua string
+ *
+ * Extracted view points directly to lua owned memory, so it is valid only as long as
+ * the stack slot it was taken from is not popped. Use BorrowedString if the string
+ * has to outlive the slot.
+ */
+template<>
+struct Stack<std::string_view>
+{
+	static void push(lua_State * state, std::string_view str)
+	{
+		lua_pushlstring(state, str.data(), str.size());
+	}
+
+	static std::string_view get(lua_State * state, int idx)
+	{
+		std::size_t len;
+		const char * str = lua_tolstring(state, idx, &len);
+		return std::string_view(str, len);
+	}
+
+	static bool is(lua_State * state, int idx)
+	{
+		return lua_isstring(state, idx);
+	}
+
+	static Error safeGet(lua_State * state, std::string_view & str, int idx)
+	{
+		if(!lua_isstring(state, idx))
+			return Error::stackError(LUA_TSTRING, lua_type(state, idx));
+
+		str = get(state, idx);
+		return Error::noError();
+	}
+};
+
+template<>
+struct Stack<BorrowedString>
+{
+	static void push(lua_State * state, const BorrowedString & str)
+	{
+		lua_pushlstring(state, str.data(), str.size());
+	}
+
+	static BorrowedString get(lua_State * state, int idx)
+	{
+		idx = lua_absindex(state, idx);
+		// lua_tolstring converts numbers in place, so the pinned value is
+		// always the string the view points to
+		std::size_t len;
+		const char * str = lua_tolstring(state, idx, &len);
+		lua_pushvalue(state, idx);
+		return BorrowedString(std::string_view(str, len), Reference::createFromStack(state));
+	}
+
+	static bool is(lua_State * state, int idx)
+	{
+		return lua_isstring(state, idx);
+	}
+
+	static Error safeGet(lua_State * state, BorrowedString & str, int idx)
+	{
+		if(!lua_isstring(state, idx))
+			return Error::stackError(LUA_TSTRING, lua_type(state, idx));
+
+		str = get(state, idx);
 		return Error::noError();
 	}
 };
@@ -75,13 +148,10 @@ struct Stack<const char *>
 		return lua_isstring(state, idx);
 	}
 
-	template<class U>
-	static Error safe_get(lua_State * state, U & str, int idx)
+	static Error safeGet(lua_State * state, const char * & str, int idx)
 	{
 		if(!lua_isstring(state, idx))
-			return Error::stackError(
-				(boost::format("expected cstring, %1% found")
-				% lua_typename(state, lua_type(state, idx))).str());
+			return Error::stackError(LUA_TSTRING, lua_type(state, idx));
 
 		str = lua_tostring(state, idx);
 		return Error::noError();
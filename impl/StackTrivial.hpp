@@ -17,23 +17,53 @@
 #pragma once
 
 #include "Stack.hpp"
+#include "Metatable.hpp"
+#include "../utils/Traits.hpp"
 #include "../Error.hpp"
 
 #include  <lua.hpp>
 
 #include <type_traits>
-#include <cstdlib>
+#include <new>
+#include <utility>
 
 namespace smartlua { namespace impl
 {
 
 template<class T>
-struct Stack<T, typename std::enable_if<std::is_trivially_destructible<T>::value && !std::is_fundamental<T>::value>::type>
+struct Stack<T, typename std::enable_if<
+	std::is_trivially_destructible<T>::value &&
+	!std::is_fundamental<T>::value &&
+	!std::is_pointer<T>::value &&
+	!utils::is_luatable_type<T>::value
+	>::type>
 {
 	static void push(lua_State * state, const T & val)
+	{
+		emplace(state, val);
+	}
+
+	/**
+	 * Constructs object directly in new userdata
+	 */
+	template<class... Args>
+	static void emplace(lua_State * state, Args &&... args)
 	{
 		T * ptr = static_cast<T *>(lua_newuserdata(state, sizeof(T)));
-		memcpy(ptr, &val, sizeof(T));
+		new(ptr) T(std::forward<Args>(args)...);
+		pushMetatable(state);
+		lua_setmetatable(state, -2);
+	}
+
+	/**
+	 * Pushes metatable shared by all userdata of this type
+	 *
+	 * There is nothing to destroy, so metatable is created empty, and is used only to
+	 * identify the type and to keep methods of bound classes.
+	 */
+	static void pushMetatable(lua_State * state)
+	{
+		Metatable<T>::push(state, [](lua_State *) { });
 	}
 
 	static T get(lua_State * state, int idx)
@@ -43,18 +73,15 @@ struct Stack<T, typename std::enable_if<std::is_trivially_destructible<T>::value
 
 	static bool is(lua_State * state, int idx)
 	{
-		return lua_isuserdata(state, idx) || lua_islightuserdata(state, idx);
+		return lua_type(state, idx) == LUA_TUSERDATA && Metatable<T>::is(state, idx);
 	}
 
-	template<class U=T>
-	static Error safe_get(lua_State * state, U & result, int idx)
+	static Error safeGet(lua_State * state, T & result, int idx)
 	{
-		if(!(lua_isuserdata(state, idx) || lua_islightuserdata(state, idx)))
-			return Error::stackError(
-				(boost::format("expected pod, %1% found")
-				% lua_typename(state, lua_type(state, idx))).str());
+		if(!is(state, idx))
+			return Error::stackError(LUA_TUSERDATA, lua_type(state, idx));
 
-		result = *static_cast<T>(lua_touserdata(state, idx));
+		result = *static_cast<T *>(lua_touserdata(state, idx));
 		return Error::noError();
 	}
 };
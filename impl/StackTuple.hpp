@@ -14,6 +14,8 @@
  * copyrigt Bartłomiej Kuras, 2015
  */
 
+#pragma once
+
 #include "Stack.hpp"
 #include "../utils/Traits.hpp"
 #include "../Error.hpp"
@@ -26,169 +28,140 @@
 namespace smartlua { namespace impl
 {
 
+template<class Tuple>
+struct TupleStep
+{
+	static constexpr Error::Step value = Error::Step::TUPLE;
+};
+
+template<class T, std::size_t N>
+struct TupleStep<std::array<T, N>>
+{
+	static constexpr Error::Step value = Error::Step::ARRAY;
+};
+
+/**
+ * Elements of tuple-like type, kept in array part of lua table
+ */
 template<int N, class Tuple>
 struct StackTupleHelper
 {
-	static constexpr int tableTypes = StackTupleHelper<N-1, Tuple>::tableTypes +
-		(utils::is_luatable_type<typename std::tuple_element<N-1, Tuple>::tuple_element>::value ? 1 : 0);
+	typedef typename std::tuple_element<N-1, Tuple>::type Element;
 
 	static void push(lua_State * state, const Tuple & t)
 	{
-		lua_pushinteger(state, N);
-		Stack<typename std::tuple_element<N-1, Tuple>::tuple_element>::push(state, std::get<N-1>(t));
-		lua_settable(state, -3);
-
 		StackTupleHelper<N-1, Tuple>::push(state, t);
+
+		Stack<Element>::push(state, std::get<N-1>(t));
+		lua_rawseti(state, -2, N);
 	}
 
 	static void get(lua_State * state,  Tuple & t, int idx)
 	{
-		lua_pushinteger(state, N);
-		lua_gettable(state, idx);
-		std::get<N-1>(t) = Stack<typename std::tuple_element<N-1, Tuple>::tuple_element>::get(state, -1);
-		lua_pop(state, 1);
-
 		StackTupleHelper<N-1, Tuple>::get(state, t, idx);
+
+		lua_rawgeti(state, idx, N);
+		std::get<N-1>(t) = Stack<Element>::get(state, -1);
+		lua_pop(state, 1);
 	}
 
 	static bool is(lua_State * state, int idx)
 	{
-		lua_pushinteger(state, N);
-		lua_gettable(state, idx);
-		if(!Stack<typename std::tuple_element<N-1, Tuple>::tuple_element>::is(state, -1))
-		{
-			lua_pop(state, 1);
+		if(!StackTupleHelper<N-1, Tuple>::is(state, idx))
 			return false;
-		}
-		lua_pop(state, 1);
 
-		return StackTupleHelper<N-1, Tuple>::is(state, idx);
+		lua_rawgeti(state, idx, N);
+		bool result = Stack<Element>::is(state, -1);
+		lua_pop(state, 1);
+		return result;
 	}
 
 	static Error safeGet(lua_State * state, Tuple & t, int idx)
 	{
-		lua_pushinteger(state, N);
-		lua_gettable(state, idx);
-		auto e = Stack<typename std::tuple_element<N-1, Tuple>::tuple_element>::safe_get(state, std::get<N-1>(t), idx);
+		auto e = StackTupleHelper<N-1, Tuple>::safeGet(state, t, idx);
 		if(!e)
-		{
-			return Error::stackError(
-				(boost::format("tuple[%1%]") % N).str(),
-				e.desc);
-			lua_pop(state, 1);
 			return e;
-		}
+
+		lua_rawgeti(state, idx, N);
+		e = Stack<Element>::safeGet(state, std::get<N-1>(t), -1);
 		lua_pop(state, 1);
+		if(!e)
+			return e.at(TupleStep<Tuple>::value, N);
 
-		return StackTupleHelper<N-1, Tuple>::safe_get(state, t, idx);
+		return Error::noError();
 	}
 };
 
 template<class Tuple>
 struct StackTupleHelper<0, Tuple>
 {
-	static constexpr int tableTypes = 0;
-
 	static void push(lua_State *, const Tuple &) { }
 	static void get(lua_State *, Tuple &, int) { }
 	static bool is(lua_State *, int) { return true; }
+	static Error safeGet(lua_State *, Tuple &, int) { return Error::noError(); }
 };
 
 template<class... Args>
 struct Stack<std::tuple<Args...>>
 {
+	typedef StackTupleHelper<sizeof...(Args), std::tuple<Args...>> Helper;
+
 	static void push(lua_State * state, const std::tuple<Args...> & t)
 	{
-		lua_createtable(state,
-			StackTupleHelper<sizeof...(Args), std::tuple<Args...>>::tableTypes,
-			sizeof...(Args) - StackTupleHelper<sizeof...(Args), std::tuple<Args...>>::tableTypes);
-		StackTupleHelper<sizeof...(Args), std::tuple<Args...>>::push(state, t);
+		lua_createtable(state, sizeof...(Args), 0);
+		Helper::push(state, t);
 	}
 
-	template<class U=std::tuple<Args...>>
-	static U get(lua_State * state, int idx)
+	static std::tuple<Args...> get(lua_State * state, int idx)
 	{
 		std::tuple<Args...> result;
-		StackTupleHelper<sizeof...(Args), std::tuple<Args...>>::get(state, result, lua_absindex(state, idx));
+		Helper::get(state, result, lua_absindex(state, idx));
 		return result;
 	}
 
 	static bool is(lua_State * state, int idx)
 	{
-		return StackTupleHelper<sizeof...(Args), std::tuple<Args...>>::is(state, lua_absindex(state, idx));
+		return lua_istable(state, idx) && Helper::is(state, lua_absindex(state, idx));
 	}
 
-	template<class U>
-	static Error safe_get(lua_State * state, U & result, int idx)
+	static Error safeGet(lua_State * state, std::tuple<Args...> & result, int idx)
 	{
 		if(!lua_istable(state, idx))
-			return Error::stackError(
-				(boost::format("expected tuple, %1% found")
-				% lua_typename(state, lua_type(state, idx))).str());
-
-		std::tuple<Args...> tmpResult;
-		auto e = StackTupleHelper<sizeof...(Args), std::tuple<Args...>>::safeGet(state, tmpResult, lua_absindex(state, idx));
-		result = std::move(tmpResult);
-		return e;
-	}
+			return Error::stackError(LUA_TTABLE, lua_type(state, idx));
 
-	static bool safe_get(lua_State * state, std::tuple<Args...> & result, int idx)
-	{
-		if(!lua_istable(state, idx))
-			return Error::stackError(
-				(boost::format("expected tuple, %1% found")
-				% lua_typename(state, lua_type(state, idx))).str());
-
-		return StackTupleHelper<sizeof...(Args), std::tuple<Args...>>::safeGet(state, result, lua_absindex(state, idx));
+		return Helper::safeGet(state, result, lua_absindex(state, idx));
 	}
 };
 
-template<class T, int N>
+template<class T, std::size_t N>
 struct Stack<std::array<T, N>>
 {
+	typedef StackTupleHelper<N, std::array<T, N>> Helper;
+
 	static void push(lua_State * state, const std::array<T, N> & t)
 	{
-		lua_createtable(state,
-			StackTupleHelper<N, std::array<T, N>>::tableTypes,
-			N - StackTupleHelper<N, std::array<T, N>>::tableTypes);
-		StackTupleHelper<N, std::array<T, N>>::push(state, t);
+		lua_createtable(state, N, 0);
+		Helper::push(state, t);
 	}
 
-	template<class U=std::array<T, N>>
-	static U get(lua_State * state, int idx)
+	static std::array<T, N> get(lua_State * state, int idx)
 	{
 		std::array<T, N> result;
-		StackTupleHelper<N, std::array<T, N>>::get(state, result, lua_absindex(state, idx));
+		Helper::get(state, result, lua_absindex(state, idx));
 		return result;
 	}
 
 	static bool is(lua_State * state, int idx)
 	{
-		return StackTupleHelper<N, std::array<T, N>>::is(state, lua_absindex(state, idx));
-	}
-
-	template<class U>
-	static bool safe_get(lua_State * state, U & result, int idx)
-	{
-		if(!lua_istable(state, idx))
-			return Error::stackError(
-				(boost::format("expected array, %1% found")
-				% lua_typename(state, lua_type(state, idx))).str());
-
-		std::array<T, N> tmpResult;
-		auto e = StackTupleHelper<N, std::array<T, N>>::safeGet(state, tmpResult, lua_absindex(state, idx));
-		result = std::move(tmpResult);
-		return e;
+		return lua_istable(state, idx) && Helper::is(state, lua_absindex(state, idx));
 	}
 
-	static bool safe_get(lua_State * state, std::array<T, N> & result, int idx)
+	static Error safeGet(lua_State * state, std::array<T, N> & result, int idx)
 	{
 		if(!lua_istable(state, idx))
-			return Error::stackError(
-				(boost::format("expected array, %1% found")
-				% lua_typename(state, lua_type(state, idx))).str());
+			return Error::stackError(LUA_TTABLE, lua_type(state, idx));
 
-		return StackTupleHelper<N, std::array<T, N>>::safeGet(state, result, lua_absindex(state, idx));;
+		return Helper::safeGet(state, result, lua_absindex(state, idx));
 	}
 };
 
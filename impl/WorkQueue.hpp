@@ -0,0 +1,238 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+#pragma once
+
+#include <lua.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace smartlua { namespace impl
+{
+
+class FunctionCache;
+
+/**
+ * Job executed on lua state of some worker
+ */
+class Task
+{
+public:
+	virtual ~Task() = default;
+	/**
+	 * \param functions Function handles of the state, kept by the worker
+	 */
+	virtual void run(lua_State * state, FunctionCache & functions) = 0;
+	/**
+	 * Reports exception thrown by run as result of the task
+	 */
+	virtual void abort(const char * message) = 0;
+
+private:
+	friend class TaskInbox;
+
+	Task * next = nullptr;
+};
+
+/**
+ * Lock-free queue of tasks submitted to worker by other threads
+ *
+ * Any thread may push, and any thread may take all queued tasks at once, so idle
+ * workers can take tasks which busy worker didn't get to yet.
+ */
+class TaskInbox
+{
+public:
+	TaskInbox():
+		head(nullptr)
+	{ }
+
+	~TaskInbox()
+	{
+		for(Task * task = head.load(); task; )
+		{
+			Task * next = task->next;
+			delete task;
+			task = next;
+		}
+	}
+
+	void push(Task * task)
+	{
+		task->next = head.load(std::memory_order_relaxed);
+		while(!head.compare_exchange_weak(task->next, task,
+			std::memory_order_release, std::memory_order_relaxed))
+		{ }
+	}
+
+	/**
+	 * Takes all queued tasks
+	 *
+	 * \return First task, which is linked with next ones in order of submitting
+	 */
+	Task * takeAll()
+	{
+		Task * task = head.exchange(nullptr, std::memory_order_acquire);
+		Task * ordered = nullptr;
+		while(task)
+		{
+			Task * next = task->next;
+			task->next = ordered;
+			ordered = task;
+			task = next;
+		}
+		return ordered;
+	}
+
+	/**
+	 * \return Task following given one taken with takeAll
+	 */
+	static Task * next(Task * task)
+	{
+		return task->next;
+	}
+
+private:
+	std::atomic<Task *> head;
+};
+
+/**
+ * Lock-free work-stealing deque of tasks
+ *
+ * Chase-Lev deque: the owning worker pushes and takes at the bottom, while other
+ * workers steal from the top. Buffers replaced on growth are kept until the deque
+ * is destroyed, as thieves may still read them. Race for the last task is ordered
+ * by sequentially consistent operations on top and bottom rather than by fences,
+ * which thread sanitizer doesn't model.
+ */
+class WorkDeque
+{
+public:
+	WorkDeque():
+		top(0),
+		bottom(0)
+	{
+		buffers.emplace_back(new Buffer(64));
+		array.store(buffers.back().get(), std::memory_order_relaxed);
+	}
+
+	~WorkDeque()
+	{
+		while(Task * task = take())
+			delete task;
+	}
+
+	/**
+	 * Pushes task, only by owner
+	 */
+	void push(Task * task)
+	{
+		std::int64_t b = bottom.load(std::memory_order_relaxed);
+		std::int64_t t = top.load(std::memory_order_acquire);
+		Buffer * a = array.load(std::memory_order_relaxed);
+		if(b - t > a->size - 1)
+			a = grow(a, t, b);
+
+		a->at(b).store(task, std::memory_order_relaxed);
+		bottom.store(b + 1, std::memory_order_release);
+	}
+
+	/**
+	 * Takes most recently pushed task, only by owner
+	 *
+	 * \return Task, or nullptr if deque is empty
+	 */
+	Task * take()
+	{
+		std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		Buffer * a = array.load(std::memory_order_relaxed);
+		bottom.store(b, std::memory_order_seq_cst);
+		std::int64_t t = top.load(std::memory_order_seq_cst);
+
+		Task * task = nullptr;
+		if(t <= b)
+		{
+			task = a->at(b).load(std::memory_order_relaxed);
+			if(t == b)
+			{
+				if(!top.compare_exchange_strong(t, t + 1,
+					std::memory_order_seq_cst, std::memory_order_relaxed))
+					task = nullptr;
+				bottom.store(b + 1, std::memory_order_relaxed);
+			}
+		}
+		else
+		{
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return task;
+	}
+
+	/**
+	 * Steals least recently pushed task, by any thread
+	 *
+	 * \return Task, or nullptr if deque is empty or other thread won the race
+	 */
+	Task * steal()
+	{
+		std::int64_t t = top.load(std::memory_order_seq_cst);
+		std::int64_t b = bottom.load(std::memory_order_seq_cst);
+
+		if(t >= b)
+			return nullptr;
+
+		Buffer * a = array.load(std::memory_order_acquire);
+		Task * task = a->at(t).load(std::memory_order_relaxed);
+		if(!top.compare_exchange_strong(t, t + 1,
+			std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return task;
+	}
+
+private:
+	struct Buffer
+	{
+		Buffer(std::int64_t size_):
+			size(size_),
+			slots(new std::atomic<Task *>[size_])
+		{ }
+
+		std::atomic<Task *> & at(std::int64_t i) { return slots[i & (size - 1)]; }
+
+		std::int64_t size;
+		std::unique_ptr<std::atomic<Task *>[]> slots;
+	};
+
+	Buffer * grow(Buffer * old, std::int64_t t, std::int64_t b)
+	{
+		buffers.emplace_back(new Buffer(old->size * 2));
+		Buffer * a = buffers.back().get();
+		for(std::int64_t i = t; i < b; ++i)
+			a->at(i).store(old->at(i).load(std::memory_order_relaxed), std::memory_order_relaxed);
+		array.store(a, std::memory_order_release);
+		return a;
+	}
+
+	alignas(64) std::atomic<std::int64_t> top;
+	alignas(64) std::atomic<std::int64_t> bottom;
+	std::atomic<Buffer *> array;
+	std::vector<std::unique_ptr<Buffer>> buffers;
+};
+
+} }
@@ -0,0 +1,159 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Test.hpp"
+
+#include "CFunction.hpp"
+#include "Function.hpp"
+#include "MultireturnFunction.hpp"
+
+#include <cstring>
+#include <string>
+#include <tuple>
+
+using namespace smartlua;
+
+namespace
+{
+
+const char * script = R"(
+	function add(a, b) return a + b end
+	function fail(a) error('failed ' .. a, 0) end
+	function many() return 1, 'two', 3 end
+	function nested(a) return twice(a) + 1 end
+	notFunction = 42
+)";
+
+template<class R>
+Function<R> global(lua_State * state, const char * name)
+{
+	return Function<R>(impl::Reference::createFromGlobal(state, name), name);
+}
+
+/**
+ * Pushes marker values which calls must leave in place
+ */
+void pushMarkers(lua_State * state)
+{
+	lua_pushinteger(state, 7);
+	lua_pushstring(state, "marker");
+}
+
+bool markersKept(lua_State * state)
+{
+	return lua_gettop(state) == 2 && lua_tointeger(state, 1) == 7 &&
+		std::strcmp(lua_tostring(state, 2), "marker") == 0;
+}
+
+}
+
+SMARTLUA_TEST(call_frame)
+{
+	test::State state;
+	state.run(script);
+
+	{
+		impl::CallFrame outer(state);
+		lua_pushinteger(state, 1);
+		{
+			impl::CallFrame inner(state);
+			CHECK(inner.getBase() == outer.getBase() + 1);
+			inner.push(2, std::string("three"));
+			CHECK(inner.size() == 2);
+			CHECK(lua_tointeger(state, inner.index(1)) == 2);
+		}
+		CHECK(outer.size() == 1);
+	}
+	CHECK(lua_gettop(state) == 0);
+
+	pushMarkers(state);
+
+	auto add = global<int>(state, "add");
+	CHECK(add(1, 2) == 3);
+	CHECK(add.error());
+	CHECK(markersKept(state));
+
+	auto many = global<MultiReturn<int, std::string, int>>(state, "many");
+	CHECK(many() == std::make_tuple(1, std::string("two"), 3));
+	CHECK(markersKept(state));
+
+	auto all = global<MultiReturn<int>>(state, "many");
+	CHECK(all().size() == 1);
+	CHECK(all.error().code == Error::Code::STACK_ERROR);
+	CHECK(markersKept(state));
+
+	auto twice = global<int>(state, "add");
+	registerFunction(state, "twice", [&](int a) {
+		return twice(a, a);
+	});
+	auto nested = global<int>(state, "nested");
+	CHECK(nested(5) == 11);
+	CHECK(nested.error());
+	CHECK(markersKept(state));
+
+	lua_settop(state, 0);
+}
+
+SMARTLUA_TEST(call_frame_errors)
+{
+	test::State state;
+	state.run(script);
+	pushMarkers(state);
+
+	auto fail = global<int>(state, "fail");
+	CHECK(fail(1) == 0);
+	Error error = fail.error();
+	CHECK(error.code == Error::Code::RUNTIME_ERROR);
+	CHECK(error.message() == "function fail: runtime error (failed 1)");
+	CHECK(markersKept(state));
+
+	auto add = global<int>(state, "add");
+	CHECK(add(1, std::string("x")) == 0);
+	CHECK(add.error().code == Error::Code::RUNTIME_ERROR);
+	CHECK(markersKept(state));
+
+	auto text = global<std::string>(state, "add");
+	CHECK(text(1, 2) == "3");
+	auto number = global<std::vector<int>>(state, "add");
+	number(1, 2);
+	CHECK(number.error().code == Error::Code::STACK_ERROR);
+	CHECK(markersKept(state));
+
+	auto notFunction = global<int>(state, "notFunction");
+	CHECK(!notFunction);
+	CHECK(notFunction.error().code == Error::Code::BAD_REFERENCE_TYPE);
+	CHECK(notFunction(1) == 0);
+	CHECK(notFunction.error().code == Error::Code::EMPTY_REFERENCE_USAGE);
+	CHECK(markersKept(state));
+
+	auto missing = global<void>(state, "missing");
+	missing();
+	CHECK(missing.error().code == Error::Code::EMPTY_REFERENCE_USAGE);
+	CHECK(markersKept(state));
+
+	// error thrown by lua function called back from C++ function within a call
+	registerFunction(state, "callFail", [&](int a) {
+		return fail(a);
+	});
+	auto callFail = global<int>(state, "callFail");
+	CHECK(callFail(2) == 0);
+	CHECK(callFail.error());
+	CHECK(fail.error().code == Error::Code::RUNTIME_ERROR);
+	CHECK(markersKept(state));
+
+	lua_settop(state, 0);
+}
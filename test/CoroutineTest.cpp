@@ -0,0 +1,199 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Test.hpp"
+
+#include "Function.hpp"
+#include "StatePool.hpp"
+#include "impl/CoroutinePool.hpp"
+
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace smartlua;
+
+namespace
+{
+
+const char * script = R"(
+	function request(id)
+		local reply = coroutine.yield(id, 'waiting')
+		return id + reply
+	end
+	function fail(id)
+		coroutine.yield(id)
+		error('failed ' .. id, 0)
+	end
+	closed = 0
+	function guarded()
+		local guard <close> = setmetatable({}, { __close = function() closed = closed + 1 end })
+		coroutine.yield()
+	end
+	function forever() while true do end end
+)";
+
+}
+
+SMARTLUA_TEST(coroutine)
+{
+	test::State state;
+	state.run(script);
+
+	Function<int> request(impl::Reference::createFromGlobal(state, "request"), "request");
+	Coroutine call = request.start(5);
+	CHECK(call.suspended());
+	CHECK(call.size() == 2);
+	int id = 0;
+	std::string text;
+	CHECK(call.get(id));
+	CHECK(call.get(text, 2));
+	CHECK(id == 5);
+	CHECK(text == "waiting");
+	CHECK(call.get(id, 3).code == Error::Code::STACK_ERROR);
+
+	CHECK(call.resume(10));
+	CHECK(call.finished());
+	CHECK(call.get(id));
+	CHECK(id == 15);
+
+	Error e = call.resume(1);
+	CHECK(e.message() == "function request: runtime error (cannot resume non-suspended coroutine)");
+	CHECK(lua_gettop(state) == 0);
+}
+
+SMARTLUA_TEST(coroutine_errors)
+{
+	test::State state;
+	state.run(script);
+
+	Function<void> fail(impl::Reference::createFromGlobal(state, "fail"), "fail");
+	Coroutine call = fail.start(3);
+	CHECK(call.suspended());
+	Error e = call.resume();
+	CHECK(call.getStatus() == Coroutine::Status::FAILED);
+	CHECK(e.message() == "function fail: runtime error (failed 3)");
+	int value = 0;
+	CHECK(call.get(value).code == Error::Code::RUNTIME_ERROR);
+	CHECK(call.resume().code == Error::Code::RUNTIME_ERROR);
+
+	Function<void> missing(impl::Reference::createFromGlobal(state, "missing"), "missing");
+	Coroutine empty = missing.start();
+	CHECK(empty.error().message() == "function missing: empty reference usage while coroutine start");
+
+	Function<void> forever(impl::Reference::createFromGlobal(state, "forever"), "forever");
+	forever.setLimit(ExecutionLimit { 10000 });
+	Coroutine stuck = forever.start();
+	CHECK(stuck.error().code == Error::Code::TIMEOUT_ERROR);
+	CHECK(lua_gettop(state) == 0);
+}
+
+SMARTLUA_TEST(coroutine_pool)
+{
+	test::State state;
+	state.run(script);
+	Function<int> request(impl::Reference::createFromGlobal(state, "request"), "request");
+	Function<void> fail(impl::Reference::createFromGlobal(state, "fail"), "fail");
+	Function<void> guarded(impl::Reference::createFromGlobal(state, "guarded"), "guarded");
+
+	// finished, failed and abandoned calls all give their threads back
+	for(int i = 0; i < 1000; ++i)
+	{
+		Coroutine call = request.start(i);
+		if(i % 3 == 0)
+			call.resume(1);
+		else if(i % 3 == 1)
+			fail.start(i).resume();
+	}
+	auto pool = impl::CoroutinePool::of(state);
+	CHECK(pool);
+	CHECK(pool->highWater() == 2);
+	CHECK(pool->size() == 2);
+
+	{
+		std::vector<Coroutine> calls;
+		for(int i = 0; i < 10; ++i)
+			calls.push_back(request.start(i));
+		CHECK(pool->highWater() == 10);
+		CHECK(pool->size() == 0);
+
+		// moved calls are released once
+		Coroutine moved(std::move(calls.back()));
+		calls.back() = request.start(100);
+		CHECK(calls.back().suspended());
+		CHECK(moved.suspended());
+	}
+	CHECK(pool->highWater() == 11);
+	CHECK(pool->size() == 11);
+
+	// abandoned thread is closed before reuse
+	guarded.start();
+	lua_getglobal(state, "closed");
+	CHECK(lua_tointeger(state, -1) == 1);
+	lua_pop(state, 1);
+
+	Coroutine reused = request.start(1);
+	CHECK(reused.resume(2));
+	int value = 0;
+	CHECK(reused.get(value));
+	CHECK(value == 3);
+	CHECK(lua_gettop(state) == 0);
+}
+
+SMARTLUA_TEST(coroutine_threads)
+{
+	const int THREADS = 4;
+	const int CALLS = 2000;
+
+	StatePool pool(THREADS, { { script, "script" } });
+	std::vector<int> wrong(THREADS);
+	std::vector<std::thread> threads;
+	for(int t = 0; t < THREADS; ++t)
+	{
+		threads.emplace_back([&, t] {
+			auto lease = pool.checkout();
+			auto request = lease.function<int>("request");
+
+			// interleaved calls suspended on the same state
+			std::vector<Coroutine> calls;
+			for(int i = 0; i < CALLS; ++i)
+			{
+				calls.push_back(request.start(i));
+				if(calls.size() < 8)
+					continue;
+
+				for(auto & call: calls)
+				{
+					int id = 0;
+					call.get(id);
+					int result = 0;
+					if(!call.resume(1) || !call.get(result) || result != id + 1)
+						++wrong[t];
+				}
+				calls.clear();
+			}
+			if(impl::CoroutinePool::of(lease)->highWater() != 8)
+				++wrong[t];
+		});
+	}
+	for(auto & thread: threads)
+		thread.join();
+
+	for(int count: wrong)
+		CHECK(count == 0);
+}
@@ -0,0 +1,181 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Test.hpp"
+
+#include "Stack.hpp"
+
+#include <stdexcept>
+
+namespace
+{
+
+/**
+ * Argument which can't be pushed, to check exceptions thrown while running calls
+ */
+struct Unpushable { };
+
+}
+
+namespace smartlua { namespace impl
+{
+
+template<>
+struct Stack<Unpushable>
+{
+	static void push(lua_State *, const Unpushable &) { throw std::runtime_error("cannot push"); }
+	static Unpushable get(lua_State *, int) { return Unpushable(); }
+	static bool is(lua_State *, int) { return true; }
+	static Error safeGet(lua_State *, Unpushable &, int) { return Error::noError(); }
+};
+
+} }
+
+#include "Executor.hpp"
+#include "MultireturnFunction.hpp"
+
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace smartlua;
+
+namespace
+{
+
+const char * script = R"(
+	function square(x) return x * x end
+	function pair(x) return x, tostring(x) end
+	function spin(n) local s = 0 for i = 1, n do s = s + i end return s end
+	function fail(x) error('failed ' .. x, 0) end
+	function forever() while true do end end
+)";
+
+}
+
+SMARTLUA_TEST(executor)
+{
+	StatePool pool(2, { { script, "script" } });
+	Executor executor(pool);
+	CHECK(executor.error());
+	CHECK(executor.size() == 2);
+
+	auto square = executor.submit<int>("square", 7);
+	auto pair = executor.submit<MultiReturn<int, std::string>>("pair", 5);
+	auto text = executor.submit<std::string>("pair", 6);
+	auto none = executor.submit<void>("square", 1);
+
+	auto result = square.get();
+	CHECK(result);
+	CHECK(result.value == 49);
+	CHECK(pair.get().value == std::make_tuple(5, std::string("5")));
+	CHECK(text.get().value == "6");
+	CHECK(none.get());
+}
+
+SMARTLUA_TEST(executor_errors)
+{
+	{
+		StatePool pool(2, { { script, "script" } });
+		Executor executor(pool, ExecutionLimit { 100000 });
+
+		auto failed = executor.submit<int>("fail", 1);
+		auto missing = executor.submit<int>("missing", 1);
+		auto mismatch = executor.submit<std::vector<int>>("square", 2);
+		auto thrown = executor.submit<int>("square", Unpushable());
+		auto stuck = executor.submit<void>("forever");
+		auto after = executor.submit<int>("square", 3);
+
+		auto result = failed.get();
+		CHECK(result.code == Error::Code::RUNTIME_ERROR);
+		CHECK(result.message == "function fail: runtime error (failed 1)");
+		CHECK(missing.get().code == Error::Code::EMPTY_REFERENCE_USAGE);
+		CHECK(mismatch.get().code == Error::Code::STACK_ERROR);
+		result = thrown.get();
+		CHECK(result.code == Error::Code::RUNTIME_ERROR);
+		CHECK(result.message == "function square: runtime error (cannot push)");
+		CHECK(stuck.get().code == Error::Code::TIMEOUT_ERROR);
+		CHECK(after.get().value == 9);
+	}
+
+	// pool failing to load its chunks has no states, so nothing can run
+	StatePool broken(2, { { "syntax error", "broken" } });
+	Executor executor(broken);
+	CHECK(!executor.error());
+	CHECK(executor.size() == 0);
+	auto result = executor.submit<int>("square", 1).get();
+	CHECK(result.code == executor.error().code);
+}
+
+SMARTLUA_TEST(executor_stress)
+{
+	const int SUBMITTERS = 4;
+	const int CALLS = 2000;
+
+	StatePool pool(3, { { script, "script" } });
+	std::vector<int> wrong(SUBMITTERS);
+	std::vector<std::future<Result<int>>> pending;
+	{
+		Executor executor(pool);
+		std::vector<std::thread> submitters;
+		for(int s = 0; s < SUBMITTERS; ++s)
+		{
+			submitters.emplace_back([&, s] {
+				std::vector<std::future<Result<int>>> results;
+				std::vector<std::future<Result<void>>> failures;
+				for(int i = 0; i < CALLS; ++i)
+				{
+					// occasional slow call, which others are stolen around
+					if(i % 500 == 0)
+						results.push_back(executor.submit<int>("spin", 60000));
+					else
+						results.push_back(executor.submit<int>("square", i));
+					if(i % 100 == 0)
+						failures.push_back(executor.submit<void>("fail", i));
+				}
+				for(int i = 0; i < CALLS; ++i)
+				{
+					auto result = results[i].get();
+					int expected = i % 500 == 0 ? 60000 / 2 * 60001 : i * i;
+					if(!result || result.value != expected)
+						++wrong[s];
+				}
+				for(auto & failure: failures)
+				{
+					if(failure.get().code != Error::Code::RUNTIME_ERROR)
+						++wrong[s];
+				}
+			});
+		}
+		for(auto & thread: submitters)
+			thread.join();
+
+		// calls still queued when executor is destroyed are finished first
+		for(int i = 0; i < 100; ++i)
+			pending.push_back(executor.submit<int>("square", i));
+	}
+	for(int i = 0; i < 100; ++i)
+	{
+		CHECK(pending[i].wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+		CHECK(pending[i].get().value == i * i);
+	}
+	for(int count: wrong)
+		CHECK(count == 0);
+}
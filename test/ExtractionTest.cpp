@@ -0,0 +1,112 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Test.hpp"
+
+#include "Function.hpp"
+#include "Stack.hpp"
+
+#include <list>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace smartlua;
+
+namespace
+{
+
+const char * script = R"(
+	function rows(n, bad)
+		local t = {}
+		for i = 1, n do t[i] = {'key' .. i, 'value' .. i} end
+		if bad then t[bad] = {'key' .. bad, false} end
+		return t
+	end
+)";
+
+typedef std::vector<std::tuple<std::string, std::string>> Rows;
+typedef std::map<std::string, std::vector<int>> Mapping;
+
+}
+
+SMARTLUA_TEST(extraction)
+{
+	test::State state;
+	state.run(script);
+
+	Function<Rows> rows(impl::Reference::createFromGlobal(state, "rows"), "rows");
+	Rows result = rows(1000);
+	CHECK(rows.error());
+	CHECK(result.size() == 1000);
+	CHECK(result[999] == std::make_tuple(std::string("key1000"), std::string("value1000")));
+	CHECK(lua_gettop(state) == 0);
+
+	// extraction stops at the first mismatch, keeping only elements before it
+	CHECK(rows.call(result, 1000, 10).code == Error::Code::STACK_ERROR);
+	CHECK(result.size() == 9);
+	CHECK(rows.error().message() == "function rows: stack error while extracting result "
+		"at iterable[10].tuple[2] (expected string, boolean found)");
+	CHECK(lua_gettop(state) == 0);
+
+	CHECK(rows.call(result, 3));
+	CHECK(result.size() == 3);
+}
+
+SMARTLUA_TEST(extraction_checks)
+{
+	test::State state;
+	smartlua::Stack stack(state);
+
+	luaL_dostring(state, "return {1, 2, 'x', 4}");
+	CHECK(!stack.is<std::vector<int>>());
+	CHECK(stack.is<std::vector<std::string>>());
+	std::vector<int> numbers { 9, 9, 9, 9, 9 };
+	Error e = stack.safeGet(numbers);
+	CHECK(e.message() == "stack error at iterable[3] (expected integer, string found)");
+	std::list<int> list;
+	CHECK(!stack.safeGet(list));
+	CHECK(list == (std::list<int> { 1, 2 }));
+	CHECK(stack.size() == 1);
+	stack.pop();
+
+	luaL_dostring(state, "return {1, 2, 3}");
+	CHECK(stack.is<std::vector<int>>());
+	CHECK(stack.safeGet(numbers));
+	CHECK(numbers == (std::vector<int> { 1, 2, 3 }));
+	std::vector<double> contiguous { 5 };
+	CHECK(stack.safeGet(contiguous));
+	CHECK(contiguous == (std::vector<double> { 1, 2, 3 }));
+	stack.pop();
+
+	luaL_dostring(state, "return {a = {1}, b = {2, 'x'}}");
+	CHECK(!stack.is<Mapping>());
+	Mapping mapping { { "old", { } } };
+	e = stack.safeGet(mapping);
+	CHECK(e.message() == "stack error at iterable value.iterable[2] (expected integer, string found)");
+	CHECK(mapping.count("old") == 0);
+	CHECK(stack.size() == 1);
+	stack.pop();
+
+	luaL_dostring(state, "return 'text'");
+	e = stack.safeGet(numbers);
+	CHECK(e.message() == "stack error (expected table, string found)");
+	CHECK(numbers.size() == 3);
+	stack.pop();
+	CHECK(stack.size() == 0);
+}
@@ -0,0 +1,175 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Test.hpp"
+
+#include "Function.hpp"
+#include "MultireturnFunction.hpp"
+#include "impl/SharedReference.hpp"
+
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace smartlua;
+
+namespace
+{
+
+struct Name
+{
+	std::string name;
+};
+
+typedef impl::BasicSharedReference<Name> NamedReference;
+
+/**
+ * \return Whether registry slot is free, so it's taken by next reference created
+ */
+bool released(lua_State * state, int slot)
+{
+	lua_pushboolean(state, 1);
+	int ref = luaL_ref(state, LUA_REGISTRYINDEX);
+	luaL_unref(state, LUA_REGISTRYINDEX, ref);
+	return ref == slot;
+}
+
+}
+
+SMARTLUA_TEST(reference)
+{
+	test::State state;
+	state.run("function f() return 1 end");
+
+	{
+		impl::Reference ref = impl::Reference::createFromGlobal(state, "f");
+		impl::Reference copy(ref);
+		CHECK(copy.getRef() != ref.getRef());
+		CHECK(lua_gettop(state) == 0);
+		impl::Reference moved(std::move(copy));
+		CHECK(!copy);
+		CHECK(moved);
+	}
+
+	int slot = LUA_NOREF;
+	{
+		impl::SharedReference ref(impl::Reference::createFromGlobal(state, "f"));
+		slot = ref.view().getRef();
+		{
+			impl::SharedReference copy(ref);
+			impl::SharedReference assigned(state);
+			assigned = copy;
+			CHECK(copy.view().getRef() == slot);
+			CHECK(assigned.view().getRef() == slot);
+			CHECK(lua_gettop(state) == 0);
+		}
+		CHECK(!released(state, slot));
+
+		impl::ReferenceView view = ref.view();
+		view.push();
+		CHECK(lua_isfunction(state, -1));
+		lua_pop(state, 1);
+	}
+	CHECK(released(state, slot));
+
+	{
+		NamedReference ref(impl::Reference::createFromGlobal(state, "f"), Name { "f" });
+		NamedReference copy(ref);
+		ref.invalidate();
+		CHECK(!ref);
+		CHECK(ref.payload().name.empty());
+		CHECK(copy.payload().name == "f");
+
+		NamedReference empty(impl::Reference(state), Name { "empty" });
+		CHECK(!empty);
+		CHECK(empty.payload().name == "empty");
+	}
+}
+
+SMARTLUA_TEST(reference_moved)
+{
+	test::State state;
+	state.run("function f() return 1 end");
+
+	Function<int> f(impl::Reference::createFromGlobal(state, "f"), "f");
+	Function<int> copy(f);
+	Function<int> g(std::move(f));
+	CHECK(!f);
+	CHECK(f() == 0);
+	CHECK(f.error().message() == "function: empty reference usage while function call");
+	CHECK(f.start().error().message() == "function: empty reference usage while coroutine start");
+	CHECK(g() == 1);
+	CHECK(copy() == 1);
+
+	f = g;
+	CHECK(f() == 1);
+	g = std::move(copy);
+	CHECK(g() == 1);
+	Function<int> h(std::move(copy));
+	CHECK(!copy);
+	CHECK(copy() == 0);
+	CHECK(copy.error().code == Error::Code::EMPTY_REFERENCE_USAGE);
+
+	Function<MultiReturn<int>> multi(impl::Reference::createFromGlobal(state, "f"), "f");
+	auto other = std::move(multi);
+	CHECK(multi().empty());
+	CHECK(multi.error().message() == "function: empty reference usage while function call");
+	CHECK(other() == std::vector<int> { 1 });
+	CHECK(lua_gettop(state) == 0);
+}
+
+SMARTLUA_TEST(reference_threads)
+{
+	test::State state;
+	state.run("function f() return 1 end");
+
+	const int THREADS = 4;
+	const int COPIES = 20000;
+
+	NamedReference ref(impl::Reference::createFromGlobal(state, "f"), Name { "f" });
+	int slot = ref.view().getRef();
+	{
+		// copies are made and dropped by other threads, while the state is not used
+		std::vector<std::thread> threads;
+		std::vector<int> mismatches(THREADS);
+		for(int t = 0; t < THREADS; ++t)
+		{
+			threads.emplace_back([&, t] {
+				std::vector<NamedReference> kept;
+				for(int i = 0; i < COPIES; ++i)
+				{
+					NamedReference copy(ref);
+					if(copy.payload().name != "f" || copy.view().getRef() != slot)
+						++mismatches[t];
+					if(i % 64 == 0)
+						kept.push_back(std::move(copy));
+				}
+			});
+		}
+		for(auto & thread: threads)
+			thread.join();
+		for(int count: mismatches)
+			CHECK(count == 0);
+	}
+
+	CHECK(!released(state, slot));
+	NamedReference last(std::move(ref));
+	CHECK(!released(state, slot));
+	last.invalidate();
+	CHECK(released(state, slot));
+}
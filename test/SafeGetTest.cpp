@@ -0,0 +1,186 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Test.hpp"
+
+#include "Function.hpp"
+#include "Stack.hpp"
+
+#include <array>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+using namespace smartlua;
+
+namespace
+{
+
+struct Point
+{
+	int x;
+	int y;
+};
+
+struct Other
+{
+	int z;
+};
+
+static_assert(impl::is_extractable<int>::value, "");
+static_assert(impl::is_extractable<double>::value, "");
+static_assert(impl::is_extractable<bool>::value, "");
+static_assert(impl::is_extractable<std::string>::value, "");
+static_assert(impl::is_extractable<std::string_view>::value, "");
+static_assert(impl::is_extractable<BorrowedString>::value, "");
+static_assert(impl::is_extractable<Point *>::value, "");
+static_assert(impl::is_extractable<Point>::value, "");
+static_assert(impl::is_extractable<std::tuple<int, std::string>>::value, "");
+static_assert(impl::is_extractable<std::array<double, 3>>::value, "");
+static_assert(impl::is_extractable<std::vector<std::vector<int>>>::value, "");
+static_assert(impl::is_extractable<std::map<std::string, std::tuple<bool, int>>>::value, "");
+
+/**
+ * Evaluates lua expression and checks its conversion to T with safeGet
+ *
+ * \return Error returned by safeGet, stack is checked to be left unchanged
+ */
+template<class T>
+Error extract(test::Context & context, lua_State * state, const char * expression, T & result)
+{
+	lua_settop(state, 0);
+	std::string code = std::string("return ") + expression;
+	CHECK(luaL_dostring(state, code.c_str()) == LUA_OK);
+	Error e = smartlua::Stack(state).safeGet(result, 1);
+	CHECK(lua_gettop(state) == 1);
+	return e;
+}
+
+}
+
+SMARTLUA_TEST(safe_get)
+{
+	test::State state;
+
+	int integer = 0;
+	CHECK(extract(context, state, "42", integer));
+	CHECK(integer == 42);
+	Error e = extract(context, state, "1.5", integer);
+	CHECK(e.code == Error::Code::STACK_ERROR);
+	CHECK(e.expected == Error::TINTEGER);
+	CHECK(e.found == LUA_TNUMBER);
+	CHECK(integer == 42);
+
+	double number = 0;
+	CHECK(extract(context, state, "2.5", number));
+	CHECK(number == 2.5);
+	CHECK(!extract(context, state, "'text'", number));
+
+	bool flag = false;
+	CHECK(extract(context, state, "true", flag));
+	CHECK(flag);
+	CHECK(extract(context, state, "nil", flag).found == LUA_TNIL);
+
+	std::string text;
+	CHECK(extract(context, state, "'text'", text));
+	CHECK(text == "text");
+	CHECK(extract(context, state, "{}", text).expected == LUA_TSTRING);
+
+	std::string_view view;
+	CHECK(extract(context, state, "'view'", view));
+	CHECK(view == "view");
+	CHECK(!extract(context, state, "false", view));
+
+	BorrowedString borrowed;
+	CHECK(!extract(context, state, "print", borrowed));
+
+	Point * pointer = nullptr;
+	Point point { 1, 2 };
+	lua_settop(state, 0);
+	lua_pushlightuserdata(state, &point);
+	CHECK(smartlua::Stack(state).safeGet(pointer, 1));
+	CHECK(pointer == &point);
+	CHECK(extract(context, state, "1", pointer).expected == LUA_TLIGHTUSERDATA);
+
+	lua_settop(state, 0);
+	impl::Stack<Point>::push(state, Point { 3, 4 });
+	impl::Stack<Other>::push(state, Other { 5 });
+	Point copy { 0, 0 };
+	CHECK(smartlua::Stack(state).safeGet(copy, 1));
+	CHECK(copy.x == 3 && copy.y == 4);
+	CHECK(smartlua::Stack(state).safeGet(copy, 2).expected == LUA_TUSERDATA);
+	CHECK(copy.x == 3);
+
+	lua_settop(state, 0);
+}
+
+SMARTLUA_TEST(safe_get_containers)
+{
+	test::State state;
+
+	std::tuple<int, std::string> tuple;
+	CHECK(extract(context, state, "{1, 'one'}", tuple));
+	CHECK(tuple == std::make_tuple(1, std::string("one")));
+	Error e = extract(context, state, "{1, true}", tuple);
+	CHECK(e.message() == "stack error at tuple[2] (expected string, boolean found)");
+
+	std::array<double, 3> array;
+	CHECK(extract(context, state, "{1, 2, 3}", array));
+	CHECK(array[2] == 3);
+	e = extract(context, state, "{1, 2, 'x'}", array);
+	CHECK(e.message() == "stack error at array[3] (expected number, string found)");
+
+	std::vector<std::vector<int>> nested;
+	CHECK(extract(context, state, "{{1, 2}, {3}}", nested));
+	CHECK(nested == (std::vector<std::vector<int>> { { 1, 2 }, { 3 } }));
+	e = extract(context, state, "{{1, 2}, {3, 'x'}}", nested);
+	CHECK(e.message() == "stack error at iterable[2].iterable[2] (expected integer, string found)");
+
+	std::map<std::string, std::tuple<bool, int>> mapping;
+	CHECK(extract(context, state, "{a = {true, 1}}", mapping));
+	CHECK(mapping.at("a") == std::make_tuple(true, 1));
+	e = extract(context, state, "{a = {true, 1}, [false] = {true, 2}}", mapping);
+	CHECK(e.message() == "stack error at iterable key (expected string, boolean found)");
+	e = extract(context, state, "{a = {1, 1}}", mapping);
+	CHECK(e.message() == "stack error at iterable value.tuple[1] (expected boolean, number found)");
+
+	// deeper paths keep innermost steps
+	std::vector<std::vector<std::vector<std::vector<std::vector<int>>>>> deep;
+	e = extract(context, state, "{{{{{'x'}}}}}", deep);
+	CHECK(e.pathLength == 5);
+	CHECK(e.message() == "stack error at ...iterable[1].iterable[1].iterable[1].iterable[1] "
+		"(expected integer, string found)");
+
+	lua_settop(state, 0);
+}
+
+SMARTLUA_TEST(safe_get_results)
+{
+	test::State state;
+	state.run(R"(
+		function pairs() return {{1, 'one'}, {2, false}} end
+	)");
+
+	Function<std::vector<std::tuple<int, std::string>>> f(
+		impl::Reference::createFromGlobal(state, "pairs"), "pairs");
+	f();
+	CHECK(f.error().message() == "function pairs: stack error while extracting result "
+		"at iterable[2].tuple[2] (expected string, boolean found)");
+	CHECK(lua_gettop(state) == 0);
+}
@@ -0,0 +1,112 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#pragma once
+
+#include "../State.hpp"
+
+#include <lua.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace smartlua { namespace test
+{
+
+/**
+ * Counts failed checks of the running suite
+ */
+class Context
+{
+public:
+	/**
+	 * Reports failed check, execution of the suite continues
+	 */
+	void check(bool passed, const char * expression, const char * file, int line)
+	{
+		if(passed)
+			return;
+		++failures;
+		std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+	}
+
+	int getFailures() const { return failures; }
+
+private:
+	int failures = 0;
+};
+
+/**
+ * Lua state with standard libraries open, allocating with malloc
+ */
+class State: public smartlua::State<MallocAllocator>
+{
+public:
+	State()
+	{
+		luaL_openlibs(*this);
+	}
+
+	/**
+	 * Runs lua source, aborting the test if it fails
+	 */
+	void run(const char * code)
+	{
+		if(luaL_dostring(*this, code) != LUA_OK)
+		{
+			std::fprintf(stderr, "lua error: %s\n", lua_tostring(*this, -1));
+			std::exit(1);
+		}
+		lua_settop(*this, 0);
+	}
+};
+
+/**
+ * Group of checks, registered by SMARTLUA_TEST and run as one ctest test
+ */
+struct Suite
+{
+	typedef void (*Body)(Context &);
+
+	Suite(const char * name_, Body body_):
+		name(name_),
+		body(body_)
+	{
+		all().push_back(this);
+	}
+
+	static std::vector<Suite *> & all()
+	{
+		static std::vector<Suite *> suites;
+		return suites;
+	}
+
+	const char * name;
+	Body body;
+};
+
+} }
+
+#define SMARTLUA_TEST(name) \
+	static void name(smartlua::test::Context &); \
+	static smartlua::test::Suite name##Suite(#name, &name); \
+	static void name(smartlua::test::Context & context)
+
+#define CHECK(expression) \
+	context.check(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
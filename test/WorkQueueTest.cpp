@@ -0,0 +1,167 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Test.hpp"
+
+#include "impl/WorkQueue.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+using namespace smartlua;
+
+namespace
+{
+
+/**
+ * Task which only records that it was taken
+ */
+struct Mark: impl::Task
+{
+	Mark(int producer_, int sequence_):
+		producer(producer_),
+		sequence(sequence_)
+	{ }
+
+	void run(lua_State *, impl::FunctionCache &) override { }
+	void abort(const char *) override { }
+
+	int producer;
+	int sequence;
+};
+
+}
+
+SMARTLUA_TEST(work_deque)
+{
+	const int TASKS = 100000;
+	const int THIEVES = 3;
+
+	impl::WorkDeque deque;
+	std::vector<std::atomic<int>> taken(TASKS);
+	std::atomic<bool> done(false);
+
+	auto mark = [&](impl::Task * task) {
+		taken[static_cast<Mark *>(task)->sequence].fetch_add(1, std::memory_order_relaxed);
+		delete task;
+	};
+
+	std::vector<std::thread> thieves;
+	for(int i = 0; i < THIEVES; ++i)
+	{
+		thieves.emplace_back([&] {
+			while(!done.load(std::memory_order_acquire))
+			{
+				if(impl::Task * task = deque.steal())
+					mark(task);
+			}
+			while(impl::Task * task = deque.steal())
+				mark(task);
+		});
+	}
+
+	// owner pushes in bursts growing the buffer, and takes from the bottom between them
+	int pushed = 0;
+	while(pushed < TASKS)
+	{
+		int burst = std::min(TASKS - pushed, 1 + pushed % 500);
+		for(int i = 0; i < burst; ++i)
+			deque.push(new Mark(0, pushed++));
+		for(int i = 0; i < burst / 2; ++i)
+		{
+			if(impl::Task * task = deque.take())
+				mark(task);
+		}
+	}
+	while(impl::Task * task = deque.take())
+		mark(task);
+	done.store(true, std::memory_order_release);
+
+	for(auto & thread: thieves)
+		thread.join();
+
+	int lost = 0;
+	int repeated = 0;
+	for(auto & count: taken)
+	{
+		lost += count.load() == 0;
+		repeated += count.load() > 1;
+	}
+	CHECK(lost == 0);
+	CHECK(repeated == 0);
+	CHECK(deque.take() == nullptr);
+	CHECK(deque.steal() == nullptr);
+}
+
+SMARTLUA_TEST(task_inbox)
+{
+	const int PRODUCERS = 3;
+	const int TASKS = 30000;
+	const int CONSUMERS = 2;
+
+	impl::TaskInbox inbox;
+	std::atomic<int> producing(PRODUCERS);
+	std::atomic<int> received(0);
+	std::atomic<int> misordered(0);
+
+	std::vector<std::thread> threads;
+	for(int p = 0; p < PRODUCERS; ++p)
+	{
+		threads.emplace_back([&, p] {
+			for(int i = 0; i < TASKS; ++i)
+				inbox.push(new Mark(p, i));
+			producing.fetch_sub(1, std::memory_order_release);
+		});
+	}
+	for(int c = 0; c < CONSUMERS; ++c)
+	{
+		threads.emplace_back([&] {
+			for(;;)
+			{
+				bool last = producing.load(std::memory_order_acquire) == 0;
+				// tasks of every producer come in order of submitting within a batch
+				std::vector<int> previous(PRODUCERS, -1);
+				for(impl::Task * task = inbox.takeAll(); task; )
+				{
+					auto mark = static_cast<Mark *>(task);
+					if(mark->sequence <= previous[mark->producer])
+						misordered.fetch_add(1, std::memory_order_relaxed);
+					previous[mark->producer] = mark->sequence;
+					received.fetch_add(1, std::memory_order_relaxed);
+
+					task = impl::TaskInbox::next(task);
+					delete mark;
+				}
+				if(last)
+					break;
+			}
+		});
+	}
+	for(auto & thread: threads)
+		thread.join();
+
+	CHECK(received.load() == PRODUCERS * TASKS);
+	CHECK(misordered.load() == 0);
+	CHECK(inbox.takeAll() == nullptr);
+
+	// tasks left in inbox are deleted with it
+	impl::TaskInbox left;
+	left.push(new Mark(0, 0));
+	left.push(new Mark(0, 1));
+}
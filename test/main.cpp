@@ -0,0 +1,51 @@
+/*
+ * This file is part of SmartLua.
+ *
+ * SmartLua is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * SmartLua is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * copyrigt Bartłomiej Kuras, 2015
+ */
+
+
+#include "Test.hpp"
+
+#include <cstdio>
+#include <string>
+
+/**
+ * Usage: smartlua_test [suite]
+ *
+ * Runs all suites, or only the one with given name.
+ */
+int main(int argc, char ** argv)
+{
+	std::string filter = argc > 1 ? argv[1] : "";
+	int suites = 0;
+	int failures = 0;
+	for(auto suite: smartlua::test::Suite::all())
+	{
+		if(!filter.empty() && filter != suite->name)
+			continue;
+
+		smartlua::test::Context context;
+		suite->body(context);
+		std::printf("%-24s %s\n", suite->name, context.getFailures() ? "FAILED" : "passed");
+		failures += context.getFailures();
+		++suites;
+	}
+
+	if(!suites)
+	{
+		std::fprintf(stderr, "no suite named %s\n", filter.c_str());
+		return 1;
+	}
+	return failures ? 1 : 0;
+}
@@ -20,24 +20,148 @@
 #include <utility>
 #include <tuple>
 #include <array>
+#include <string_view>
 
 namespace smartlua { namespace utils
 {
 
+/**
+ * Signature of callable type
+ *
+ * `apply` instantiates given template with result type followed by argument types.
+ */
+template<class F>
+struct function_traits: function_traits<decltype(&F::operator())> { };
+
+template<class R, class... Args>
+struct function_traits<R (*)(Args...)>
+{
+	typedef R result_type;
+
+	template<template<class...> class Tpl>
+	using apply = Tpl<R, Args...>;
+};
+
+template<class R, class... Args>
+struct function_traits<R (*)(Args...) noexcept>: function_traits<R (*)(Args...)> { };
+
+template<class C, class R, class... Args>
+struct function_traits<R (C::*)(Args...)>: function_traits<R (*)(Args...)> { };
+
+template<class C, class R, class... Args>
+struct function_traits<R (C::*)(Args...) const>: function_traits<R (*)(Args...)> { };
+
+template<class C, class R, class... Args>
+struct function_traits<R (C::*)(Args...) noexcept>: function_traits<R (*)(Args...)> { };
+
+template<class C, class R, class... Args>
+struct function_traits<R (C::*)(Args...) const noexcept>: function_traits<R (*)(Args...)> { };
+
+/**
+ * Fixed size heterogenous or homogenous tuple, kept as lua array
+ */
+template<class T>
+struct is_tuple_type: std::false_type { };
+
+template<class... Args>
+struct is_tuple_type<std::tuple<Args...>>: std::true_type { };
+
+template<class T, std::size_t N>
+struct is_tuple_type<std::array<T, N>>: std::true_type { };
+
+/**
+ * Iterable container, kept as lua table
+ */
 template<class T, class E=void>
-struct is_luatable_type: std::false_type { };
+struct is_iterable_type: std::false_type { };
 
 template<class T>
-struct is_luatable_type<T, typename std::enable_if<
+struct is_iterable_type<T, typename std::enable_if<
+	!is_tuple_type<T>::value &&
 	!std::is_void<typename T::value_type>::value &&
 	!std::is_void<decltype(std::declval<T&>().begin())>::value &&
 	!std::is_void<decltype(std::declval<T&>().end())>::value
 >::type>: std::true_type { };
 
+template<class T>
+struct is_luatable_type: std::integral_constant<bool,
+	is_tuple_type<T>::value || is_iterable_type<T>::value> { };
+
+template<class T, class E=void>
+struct is_mapping_type: std::false_type { };
+
+template<class T>
+struct is_mapping_type<T, typename std::enable_if<
+	!std::is_void<typename T::key_type>::value &&
+	!std::is_void<typename T::mapped_type>::value
+>::type>: std::true_type { };
+
+template<class T, class E=void>
+struct has_size: std::false_type { };
+
+template<class T>
+struct has_size<T, typename std::enable_if<
+	!std::is_void<decltype(std::declval<const T&>().size())>::value
+>::type>: std::true_type { };
+
+template<class T, class E=void>
+struct has_reserve: std::false_type { };
+
+template<class T>
+struct has_reserve<T, typename std::enable_if<
+	std::is_void<decltype(std::declval<T&>().reserve(0))>::value
+>::type>: std::true_type { };
+
+/**
+ * Sequence which can construct element at its end and return reference to it
+ */
+template<class T, class E=void>
+struct has_emplace_back: std::false_type { };
+
+template<class T>
+struct has_emplace_back<T, typename std::enable_if<
+	std::is_same<decltype(std::declval<T&>().emplace_back()), typename T::value_type &>::value
+>::type>: std::true_type { };
+
+/**
+ * Resizable container keeping arithmetic values in contiguous memory
+ */
+template<class T, class E=void>
+struct is_contiguous_arithmetic_type: std::false_type { };
+
+template<class T>
+struct is_contiguous_arithmetic_type<T, typename std::enable_if<
+	std::is_arithmetic<typename T::value_type>::value &&
+	!std::is_same<typename T::value_type, bool>::value &&
+	std::is_pointer<decltype(std::declval<T&>().data())>::value &&
+	std::is_void<decltype(std::declval<T&>().resize(0))>::value
+>::type>: std::true_type { };
+
+/**
+ * Type pointing to string kept on lua stack, directly or within its elements
+ *
+ * Such value is valid only while the string stays on the stack, so it can't be
+ * returned from a call, which pops its results.
+ */
+template<class T, class E=void>
+struct is_stack_bound_type: std::integral_constant<bool,
+	std::is_same<T, std::string_view>::value || std::is_same<T, const char *>::value> { };
+
 template<class... Args>
-struct is_luatable_type<std::tuple<Args...>>: std::true_type { };
+struct is_stack_bound_type<std::tuple<Args...>>: std::integral_constant<bool,
+	(is_stack_bound_type<Args>::value || ...)> { };
 
-template<class T, int N>
-struct is_luatable_type<std::array<T, N>>: std::true_type { };
+template<class T, std::size_t N>
+struct is_stack_bound_type<std::array<T, N>>: is_stack_bound_type<T> { };
+
+template<class K, class V>
+struct is_stack_bound_type<std::pair<K, V>>: std::integral_constant<bool,
+	is_stack_bound_type<typename std::remove_const<K>::type>::value ||
+	is_stack_bound_type<V>::value> { };
+
+template<class T>
+struct is_stack_bound_type<T, typename std::enable_if<
+	is_iterable_type<T>::value && !std::is_same<T, std::string_view>::value
+>::type>: is_stack_bound_type<typename T::value_type> { };
 
 } }